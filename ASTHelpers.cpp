@@ -6,6 +6,7 @@
  ****************************************************************************/
 
 #include <algorithm>
+#include <tuple>
 
 #include "ASTHelpers.h"
 #include "CodeGenerator.h"
@@ -13,6 +14,7 @@
 #include "InsightsHelpers.h"
 #include "InsightsStaticStrings.h"
 #include "InsightsStrCat.h"
+#include "llvm/ADT/STLExtras.h"
 //-----------------------------------------------------------------------------
 
 using namespace std::literals;
@@ -747,9 +749,24 @@ void StmtsContainer::AddBodyStmts(Stmt* body)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief The replacements \ref ReplaceNode made since the last \ref RestoreReplacedNodes, the latest last.
+static std::vector<std::tuple<Stmt*, Stmt*, Stmt*>> gReplacedNodes{};
+
 void ReplaceNode(Stmt* parent, Stmt* oldNode, Stmt* newNode)
 {
     std::replace(parent->child_begin(), parent->child_end(), oldNode, newNode);
+    gReplacedNodes.emplace_back(parent, oldNode, newNode);
+}
+//-----------------------------------------------------------------------------
+
+void RestoreReplacedNodes()
+{
+    // A later replacement may have replaced the node an earlier one inserted, undo them in reverse
+    for(const auto& [parent, oldNode, newNode] : llvm::reverse(gReplacedNodes)) {
+        std::replace(parent->child_begin(), parent->child_end(), newNode, oldNode);
+    }
+
+    gReplacedNodes.clear();
 }
 //-----------------------------------------------------------------------------
 
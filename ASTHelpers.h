@@ -23,6 +23,9 @@
 
 namespace clang::insights::asthelpers {
 void ReplaceNode(Stmt* parent, Stmt* oldNode, Stmt* newNode);
+/// \brief Put the nodes \ref ReplaceNode replaced back into the AST, so that the next transformation sees it as
+/// parsed.
+void RestoreReplacedNodes();
 
 using params_vector = std::vector<std::pair<std::string_view, QualType>>;
 using params_store  = std::vector<std::pair<std::string, QualType>>;
@@ -78,6 +78,13 @@ CfrontCodeGenerator::CfrontVtableData& CfrontCodeGenerator::VtableData()
 }
 //-----------------------------------------------------------------------------
 
+void CfrontCodeGenerator::ResetState()
+{
+    mVirtualFunctions.clear();
+    mThisPointerOffset.clear();
+}
+//-----------------------------------------------------------------------------
+
 CodeGeneratorVariant::CodeGenerators::CodeGenerators(OutputFormatHelper&                      _outputFormatHelper,
                                                      CodeGenerator::LambdaStackType&          lambdaStack,
                                                      CodeGenerator::ProcessingPrimaryTemplate processingPrimaryTemplate)
@@ -233,6 +240,8 @@ void CfrontCodeGenerator::InsertArg(const CXXDeleteExpr* stmt)
     auto  destroyedType = stmt->getDestroyedType();
     auto* arg           = const_cast<Expr*>(stmt->getArgument());
 
+    InsertDeallocationComment();
+
     StmtsContainer bodyStmts{};
 
     if(const auto hasDtor{HasDtor(destroyedType)}; stmt->isArrayForm() and hasDtor) {
@@ -299,6 +308,8 @@ void CfrontCodeGenerator::InsertArg(const CXXNewExpr* cstmt)
 {
     auto* stmt = const_cast<CXXNewExpr*>(cstmt);
 
+    InsertAllocationComment(stmt);
+
     auto allocatedType = stmt->getAllocatedType();
     auto ctorName      = StrCat("Constructor_"sv, GetName(allocatedType));
 
@@ -7,6 +7,8 @@
 
 #include <algorithm>
 #include <optional>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "ASTHelpers.h"
@@ -19,10 +21,18 @@
 #include "InsightsStrCat.h"
 #include "NumberIterator.h"
 #include "clang/AST/RecordLayout.h"
+#include "clang/AST/VTableBuilder.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Sema/Sema.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/xxhash.h"
 //-----------------------------------------------------------------------------
 
 /// \brief Convenience macro to create a \ref LambdaScopeHandler on the stack.
@@ -376,6 +386,11 @@ void CodeGenerator::InsertArg(const CXXForRangeStmt* rangeForStmt)
 
     auto* outerScope = mkCompoundStmt(outerScopeStmts, rangeForStmt->getBeginLoc(), rangeForStmt->getEndLoc());
 
+    InsertLoopCostComment(rangeForStmt);
+
+    // The costs are those of the range-based for-loop, not the ones of the lowered loop
+    BackupAndRestore _{mLoweredLoop, static_cast<const Stmt*>(forStmt)};
+
     InsertArg(outerScope);
 
     mOutputFormatHelper.AppendNewLine();
@@ -441,7 +456,7 @@ void CodeGenerator::InsertArg(const VarTemplateDecl* stmt)
             mOutputFormatHelper.AppendNewLine();
         }
 
-        InsertArg(spec);
+        InsertTemplateSpecialization(stmt, spec, [&] { InsertArg(spec); });
     }
 }
 //-----------------------------------------------------------------------------
@@ -471,6 +486,10 @@ void CodeGenerator::InsertArg(const ConditionalOperator* stmt)
 
 void CodeGenerator::InsertArg(const DoStmt* stmt)
 {
+    InsertLoopCostComment(stmt);
+
+    BackupAndRestore _{mLoopDepth, mLoopDepth + 1};
+
     mOutputFormatHelper.Append(kwDoSpace);
 
     WrapInCompoundIfNeeded(stmt->getBody(), AddNewLineAfter::No);
@@ -555,6 +574,10 @@ void CodeGenerator::InsertArg(const SwitchStmt* stmt)
 
 void CodeGenerator::InsertArg(const WhileStmt* stmt)
 {
+    InsertLoopCostComment(stmt);
+
+    BackupAndRestore _{mLoopDepth, mLoopDepth + 1};
+
     {
         // We need to handle the case that a lambda is used in the init-statement of the for-loop.
         LAMBDA_SCOPE_HELPER(VarDecl);
@@ -1104,455 +1127,2051 @@ static void PushGlobalVariableDtor(const Expr* callExpr)
 }
 //-----------------------------------------------------------------------------
 
-std::string EmitGlobalVariableCtors()
+/// \brief The number of implicit conversions with a runtime cost per cast kind, see \ref GetImplicitCastCost.
+struct CostlyImplicitCast
 {
-    StmtsContainer bodyStmts{};
-
-    for(auto& e : globalVarCtors) {
-        bodyStmts.AddBodyStmts(e);
-    }
-
-    auto* cxaStartFun = Function(cxaStart, VoidTy(), {});
-    cxaStartFun->setBody(mkCompoundStmt(bodyStmts));
-
-    OutputFormatHelper ofm{};
-    ofm.AppendNewLine();
-    ofm.AppendNewLine();
-    CodeGeneratorVariant cg{ofm};
-
-    if(gVtables.size()) {
-        SmallVector<Expr*, 16> mInitExprs{};
-
-        for(auto& e : gVtables) {
-            cg->InsertArg(e.second);
-            mInitExprs.push_back(mkDeclRefExpr(e.second));
-        }
-
-        ofm.AppendNewLine();
-
-        // struct __mptr *__ptbl_vec__c___src_C_[]
-        auto* vtable = CfrontCodeGenerator::VtableData().VtblArrayVar(mInitExprs.size());
-        vtable->setInit(InitList(mInitExprs, vtable->getType()));
+    CastKind kind{};
+    unsigned cost{};
+    uint64_t count{};
+};
 
-        cg->InsertArg(vtable);
+/*constinit*/ static SmallVector<CostlyImplicitCast, 8> gCostlyImplicitCasts{};
+//-----------------------------------------------------------------------------
 
-        ofm.AppendNewLine();
+static void PushCostlyImplicitCast(CastKind kind, unsigned cost)
+{
+    if(auto iter = ranges::find_if(gCostlyImplicitCasts, [&](const auto& e) { return e.kind == kind; });
+       iter != gCostlyImplicitCasts.end()) {
+        ++iter->count;
+    } else {
+        gCostlyImplicitCasts.push_back({kind, cost, 1});
     }
+}
+//-----------------------------------------------------------------------------
 
-    cg->InsertArg(cxaStartFun);
+static std::string_view GetCostName(unsigned cost)
+{
+    switch(cost) {
+        case 3: return "high"sv;
+        case 2: return "medium"sv;
+        default: return "low"sv;
+    }
+}
+//-----------------------------------------------------------------------------
 
-    StmtsContainer bodyStmtsDtors{};
+std::string EmitCostlyImplicitCasts()
+{
+    // The counts belong to the translation unit at hand, the next one starts over
+    auto costlyCasts = std::exchange(gCostlyImplicitCasts, {});
 
-    for(auto& e : globalVarDtors) {
-        bodyStmtsDtors.AddBodyStmts(e);
+    if(costlyCasts.empty()) {
+        return {};
     }
 
-    auto* cxaAtExitFun = Function(cxaAtExit, VoidTy(), {});
-    cxaAtExitFun->setBody(mkCompoundStmt(bodyStmtsDtors));
+    OutputFormatHelper ofm{};
+
+    // Rank the casts by their estimated cost and then by the number of occurrences
+    ranges::stable_sort(costlyCasts, [](const auto& a, const auto& b) {
+        return std::tie(a.cost, a.count) > std::tie(b.cost, b.count);
+    });
 
     ofm.AppendNewLine();
-    cg->InsertArg(cxaAtExitFun);
+    ofm.AppendCommentNewLine("Costly implicit conversions:"sv);
+
+    for(const auto& e : costlyCasts) {
+        ofm.AppendCommentNewLine(
+            CastExpr::getCastKindName(e.kind), ": "sv, e.count, " ("sv, GetCostName(e.cost), ")"sv);
+    }
 
     return ofm.GetString();
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::LifetimeAddExtended(const VarDecl* vd, const ValueDecl* extending)
-{
-    mLifeTimeTracker.AddExtended(vd, extending);
-}
+/// \brief The records of the TU for the noexcept move audit, see \ref EmitNoexceptMoveAudit.
+/*constinit*/ static SmallVector<const CXXRecordDecl*, 10> gMoveAuditRecords{};
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::StartLifetimeScope()
+static void PushMoveAuditRecord(const CXXRecordDecl* record)
 {
-    mLifeTimeTracker.StartScope(false);
+    RETURN_IF(not record->isThisDeclarationADefinition() or record->isLambda() or record->isDependentType() or
+              record->isUnion() or llvm::is_contained(gMoveAuditRecords, record));
+
+    gMoveAuditRecords.push_back(record);
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::EndLifetimeScope()
+static bool IsNothrow(const CXXMethodDecl* method)
 {
-    mSkipSemi = mLifeTimeTracker.EndScope(mOutputFormatHelper, false) or mSkipSemi;
+    const auto* fpt = method->getType()->getAs<FunctionProtoType>();
+
+    // The exception specification of implicit special members is computed on demand
+    if(fpt and isUnresolvedExceptionSpec(fpt->getExceptionSpecType())) {
+        fpt = GetGlobalCI().getSema().ResolveExceptionSpec(method->getLocation(), fpt);
+    }
+
+    return fpt and fpt->isNothrow();
 }
 //-----------------------------------------------------------------------------
 
-// In a primary template we can see a ParenListExpr with a PackExpansionExpr. With the equal sign we need a type.
-static bool IsPrimaryTemplatePackExpansionExpr(const ParenListExpr* stmt)
+/// \brief Find the declared move constructor or move assignment operator of \p record.
+static const CXXMethodDecl* FindMoveMember(const CXXRecordDecl* record, bool assignment)
 {
-    return stmt and stmt->getNumExprs() and isa_and_nonnull<PackExpansionExpr>(stmt->getExpr(0)) and
-           stmt->getType().isNull();
+    if(assignment) {
+        for(const auto* method : record->methods()) {
+            if(method->isMoveAssignmentOperator()) {
+                return method;
+            }
+        }
+
+    } else {
+        for(const auto* ctor : record->ctors()) {
+            if(ctor->isMoveConstructor()) {
+                return ctor;
+            }
+        }
+    }
+
+    return nullptr;
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const LinkageSpecDecl* stmt)
+/// \brief Find the declared copy constructor or copy assignment operator of \p record an rvalue binds to.
+///
+/// That is the one taking a \c const reference, a copy operation taking a non-const reference cannot copy from an
+/// rvalue.
+static const CXXMethodDecl* FindCopyMember(const CXXRecordDecl* record, bool assignment)
 {
-    mOutputFormatHelper.Append("extern \"",
-                               (
-#if IS_CLANG_NEWER_THAN(17)
-                                   LinkageSpecLanguageIDs::C
-#else
-                                   LinkageSpecDecl::lang_c
-#endif
-                                   == stmt->getLanguage())
-                                   ? "C"sv
-                                   : "C++"sv,
-                               "\"");
-    mOutputFormatHelper.OpenScope();
+    const auto takesConstRef = [](const CXXMethodDecl* method) {
+        return method->getParamDecl(0)->getType().getNonReferenceType().isConstQualified();
+    };
 
-    for(const auto* decl : stmt->decls()) {
-        InsertArg(decl);
+    if(assignment) {
+        for(const auto* method : record->methods()) {
+            if(method->isCopyAssignmentOperator() and takesConstRef(method)) {
+                return method;
+            }
+        }
+
+    } else {
+        for(const auto* ctor : record->ctors()) {
+            if(ctor->isCopyConstructor() and takesConstRef(ctor)) {
+                return ctor;
+            }
+        }
     }
 
-    mOutputFormatHelper.CloseScope();
-    mOutputFormatHelper.AppendNewLine();
+    return nullptr;
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const VarDecl* stmt)
+/// \brief Whether the implicit move operation of \p record, which clang did not declare yet, does not throw.
+///
+/// This follows what Sema computes once it declares the member: it throws, if the operation of a base or member
+/// throws. Without a move operation a subobject is copied.
+static bool IsImplicitMoveNothrow(const CXXRecordDecl* record, bool assignment)
 {
-    if(auto* init = stmt->getInit();
-       GetInsightsOptions().UseShow2C and IsReferenceType(stmt) and
-       (not(isa<CallExpr>(init) or
-            (isa<ExprWithCleanups>(init) and
-             (isa<CallExpr>(dyn_cast_or_null<ExprWithCleanups>(init)->getSubExpr()) or
-              isa<MaterializeTemporaryExpr>(dyn_cast_or_null<ExprWithCleanups>(init)->getSubExpr())))))) {
-        return;
+    if(assignment ? record->hasTrivialMoveAssignment() : record->hasTrivialMoveConstructor()) {
+        return true;
     }
 
-    mLifeTimeTracker.Add(stmt);
+    const auto isSubobjectNothrow = [&](QualType type) {
+        const auto* rd = GetGlobalAST().getBaseElementType(type)->getAsCXXRecordDecl();
 
-    // If this is part of a DecompositionDecl then ignore this VarDecl as we already have seen and inserted it. This
-    // happens in StructuredBindingsHandler3Test.cpp
-    if(BindingDeclFinder isBindingDecl{}; isBindingDecl.Find(stmt->getInit())) {
-        return;
-    }
+        if(not rd or not rd->hasDefinition()) {
+            return true;
 
-    LAMBDA_SCOPE_HELPER(VarDecl);
-    UpdateCurrentPos(mCurrentVarDeclPos);
+        } else if(const auto* method = FindMoveMember(rd, assignment)) {
+            return IsNothrow(method);
 
-    TemporaryDeclFinder temporaryFinder{*this, stmt->getInit()};
+        } else if(assignment ? rd->needsImplicitMoveAssignment() : rd->needsImplicitMoveConstructor()) {
+            return IsImplicitMoveNothrow(rd, assignment);
 
-    if(InsertComma()) {
-        mOutputFormatHelper.Append(',');
-    }
+        } else if(const auto* copyMember = FindCopyMember(rd, assignment)) {
+            return IsNothrow(copyMember);
+        }
 
-    // If we are looking at a static member variable of a class template which is defined out-of-line we need to
-    // protect the resulting instantiations.
-    const bool needsGuard = stmt->isOutOfLine() and isTemplateInstantiation(stmt->getTemplateSpecializationKind());
+        return assignment ? rd->hasTrivialCopyAssignment() : rd->hasTrivialCopyConstructor();
+    };
 
-    // We are looking at the primary definition of a out-of-line member variable of a class template. We need to add
-    // the template head.
-    if(stmt->isOutOfLine()) {
-        if(const auto* recordDecl = dyn_cast_or_null<CXXRecordDecl>(stmt->getDeclContext())) {
-            if(const auto* classTmpl = recordDecl->getDescribedClassTemplate()) {
-                InsertTemplateParameters(*classTmpl->getTemplateParameters());
+    return ranges::all_of(record->bases(), [&](const auto& base) { return isSubobjectNothrow(base.getType()); }) and
+           ranges::all_of(record->fields(), [&](const auto* field) { return isSubobjectNothrow(field->getType()); });
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \c std::move_if_noexcept can fall back to the copy constructor of \p record.
+///
+/// Like \ref IsImplicitMoveNothrow this does not declare the implicit copy constructor. It is deleted, if the class
+/// declares a move operation or a subobject cannot be copied. A subobject's copy constructor only needs to be
+/// accessible from the derived class, the one of \p record from the container.
+static bool IsCopyConstructible(const CXXRecordDecl* record, bool subobject = false)
+{
+    bool declaresCopy{};
+
+    for(const auto* ctor : record->ctors()) {
+        if(ctor->isCopyConstructor()) {
+            declaresCopy = true;
+
+            if(not ctor->isDeleted() and
+               ((AS_public == ctor->getAccess()) or (subobject and (AS_private != ctor->getAccess())))) {
+                return true;
             }
         }
     }
 
-    if(isa<VarTemplateSpecializationDecl>(stmt)) {
-        InsertTemplateSpecializationHeader();
-    } else if(needsGuard) {
-        mOutputFormatHelper.InsertIfDefTemplateGuard();
+    if(declaresCopy or not record->needsImplicitCopyConstructor() or record->hasUserDeclaredMoveConstructor() or
+       record->hasUserDeclaredMoveAssignment()) {
+        return false;
     }
 
-    InsertAttributes(stmt->attrs());
-    InsertConceptConstraint(stmt);
-
-    if(IsTrivialStaticClassVarDecl(*stmt)) {
-        HandleLocalStaticNonTrivialClass(stmt);
+    const auto isSubobjectCopyable = [](QualType type) {
+        if(type->isRValueReferenceType()) {
+            return false;
+        }
 
-    } else {
-        if(InsertVarDecl(stmt)) {
-            const auto desugaredType = GetType(GetDesugarType(stmt->getType()));
+        const auto* rd = GetGlobalAST().getBaseElementType(type)->getAsCXXRecordDecl();
 
-            const bool isMemberPointer{isa<MemberPointerType>(desugaredType.getTypePtrOrNull())};
-            if(desugaredType->isFunctionPointerType() or isMemberPointer) {
-                const auto lineNo    = GetSM(*stmt).getSpellingLineNumber(stmt->getSourceRange().getBegin());
-                const auto ptrPrefix = isMemberPointer ? memberVariablePointerPrefix : functionPointerPrefix;
-                const auto funcPtrName{StrCat(ptrPrefix, lineNo)};
+        return not rd or not rd->hasDefinition() or IsCopyConstructible(rd, true);
+    };
 
-                mOutputFormatHelper.AppendSemiNewLine(kwUsingSpace, funcPtrName, hlpAssing, GetName(desugaredType));
-                mOutputFormatHelper.Append(GetQualifiers(*stmt), funcPtrName, " "sv, GetName(*stmt));
+    return ranges::all_of(record->bases(), [&](const auto& base) { return isSubobjectCopyable(base.getType()); }) and
+           ranges::all_of(record->fields(), [&](const auto* field) { return isSubobjectCopyable(field->getType()); });
+}
+//-----------------------------------------------------------------------------
 
-            } else {
-                mOutputFormatHelper.Append(GetQualifiers(*stmt));
+/// \brief Describe the exception specification of a move operation of \p record and who provides it.
+///
+/// Clang declares implicit special members only when they are needed. The ones not declared yet are described from
+/// the declaration data of \p record instead of declaring them here.
+static std::pair<std::string, bool> GetMoveMemberState(const CXXRecordDecl* record, bool assignment)
+{
+    const auto describe = [](bool nothrow, std::string_view provider) {
+        return std::pair{StrCat(ValueOr(nothrow, "noexcept"sv, "not noexcept"sv), " ("sv, provider, ")"sv), nothrow};
+    };
 
-                const auto scope = [&] {
-                    if(const auto* ctx = stmt->getDeclContext(); stmt->getLexicalDeclContext() != ctx) {
-                        OutputFormatHelper scopeOfm{};
-                        scopeOfm.Append(GetDeclContext(ctx, WithTemplateParameters::Yes));
+    if(const auto* method = FindMoveMember(record, assignment)) {
+        if(method->isDeleted()) {
+            return {std::string{"deleted"sv}, false};
+        }
 
-                        return ScopeHandler::RemoveCurrentScope(scopeOfm.GetString());
-                    }
+        const std::string_view provider = [&] {
+            if(method->isImplicit()) {
+                return "implicit"sv;
+            } else if(method->isUserProvided()) {
+                return "user-provided"sv;
+            }
 
-                    return std::string{};
-                }();
+            return "defaulted"sv;
+        }();
 
-                const auto varName = FormatVarTemplateSpecializationDecl(stmt, StrCat(scope, GetName(*stmt)));
+        return describe(IsNothrow(method), provider);
 
-                // TODO: to keep the special handling for lambdas, do this only for template specializations
-                mOutputFormatHelper.Append(GetTypeNameAsParameter(GetType(stmt->getType()), varName));
-            }
-        } else {
-            const std::string_view pointer = [&]() {
-                if(SkipSpaceAfterVarDecl()) {
-                    return ""sv;
-                }
+    } else if(assignment ? record->needsImplicitMoveAssignment() : record->needsImplicitMoveConstructor()) {
+        if(not assignment and record->defaultedMoveConstructorIsDeleted()) {
+            return {std::string{"deleted"sv}, false};
+        }
 
-                if(stmt->getType()->isAnyPointerType()) {
-                    return " *"sv;
-                }
-                return " "sv;
-            }();
+        return describe(IsImplicitMoveNothrow(record, assignment), "implicit"sv);
+    }
 
-            mOutputFormatHelper.Append(pointer, GetName(*stmt));
-        }
+    return {std::string{"none"sv}, false};
+}
+//-----------------------------------------------------------------------------
 
-        if(const auto* init = stmt->getInit()) {
-            if(const auto* ctorExpr = dyn_cast_or_null<CXXConstructExpr>(init);
-               GetInsightsOptions().UseShow2C and ctorExpr) {
+/// \brief A standard container which stores a record, see \ref GetStoringContainers.
+struct StoringContainer
+{
+    std::string_view name{};
+    bool             relocates{};  //!< Whether growing moves the elements to new storage, which a deque never does.
+};
+//-----------------------------------------------------------------------------
 
-                // https://stackoverflow.com/questions/45471470/how-to-generate-code-for-initializing-global-variables-with-non-const-values-in
-                // https://llvm.org/docs/LangRef.html#the-llvm-global-ctors-global-variable
-                // https://stackoverflow.com/questions/72971935/why-does-clang-do-thread-safe-init-for-some-globals-but-not-others
-                // __cxx_global_var_init
-                // https://discourse.llvm.org/t/static-constructors-cxx-global-var-initn-vs-global-sub-i-xxx/39442
-                //                if(stmt->needsDestruction(stmt->getASTContext())) {
-                //
-                // at_exit
-                // https://clang.llvm.org/doxygen/CGDeclCXX_8cpp_source.html
-                // __cxa_atexit
+/// \brief Find the \c std::vector and \c std::deque instantiations in the TU which store \p record.
+static SmallVector<StoringContainer, 2> GetStoringContainers(const CXXRecordDecl* record)
+{
+    SmallVector<StoringContainer, 2> containers{};
+    auto&                            ctx = GetGlobalAST();
 
-                //                if(not ctorExpr->getConstructor()->isTrivial()) {
-                if(stmt->hasGlobalStorage()) {
-                    // push to __cxx_global_var_init
-                    auto* callExpr = CallConstructor(
-                        stmt->getType(), stmt, ArgsToExprVector(ctorExpr), DoCast::No, AsReference::Yes);
+    for(const auto* stdDecl : ctx.getTranslationUnitDecl()->lookup(&ctx.Idents.get("std"sv))) {
+        const auto* stdNamespace = dyn_cast_or_null<NamespaceDecl>(stdDecl);
 
-                    PushGlobalVariable(callExpr);
+        if(not stdNamespace) {
+            continue;
+        }
 
-                    PushGlobalVariableDtor(CallDestructor(stmt));
+        for(const auto& [name, container] : {std::pair{"vector"sv, StoringContainer{"std::vector"sv, true}},
+                                             std::pair{"deque"sv, StoringContainer{"std::deque"sv, false}}}) {
+            for(const auto* decl : stdNamespace->lookup(&ctx.Idents.get(name))) {
+                const auto* tmpl = dyn_cast_or_null<ClassTemplateDecl>(decl);
 
-                } else {
-                    mOutputFormatHelper.AppendSemiNewLine();
-                    InsertArg(init);
+                if(not tmpl or ranges::any_of(containers, [&](const auto& c) { return c.name == container.name; })) {
+                    continue;
                 }
-                //                }
 
-            } else {
-                mProcessingVarDecl = false;
-                BackupAndRestore _{mProcessingVarDecl, true};
+                const bool storesRecord = ranges::any_of(tmpl->specializations(), [&](const auto* spec) {
+                    const auto& args = spec->getTemplateArgs();
 
-                if(MyOptional<const InitListExpr*> initList{dyn_cast_or_null<InitListExpr>(init)};
-                   GetInsightsOptions().UseShow2C and
-                   initList.and_then(CanonicalType).and_then(Isa<RecordType>).and_not(IsPointer).and_then(IsPOD) and
-                   not isa<ArrayType>(stmt->getType())) {
-                    auto* callMemset = Call("memset"sv, {Ref(stmt), Int32(0), Sizeof(stmt->getType())});
+                    if(args.size() and (TemplateArgument::Type == args[0].getKind())) {
+                        if(const auto* rd = args[0].getAsType()->getAsCXXRecordDecl()) {
+                            return rd->getCanonicalDecl() == record->getCanonicalDecl();
+                        }
+                    }
 
-                    EnableGlobalInsert(GlobalInserts::FuncMemset);
+                    return false;
+                });
 
-                    if(stmt->hasGlobalStorage()) {
-                        PushGlobalVariable(callMemset);
+                if(storesRecord) {
+                    containers.push_back(container);
+                }
+            }
+        }
+    }
 
-                    } else {
-                        mOutputFormatHelper.AppendSemiNewLine();
-                        InsertArg(callMemset);
-                    }
+    return containers;
+}
+//-----------------------------------------------------------------------------
 
-                } else if(not(GetInsightsOptions().UseShow2C and
-                              initList.and_then(CanonicalType)
-                                  .and_then(Isa<RecordType>)
-                                  .and_not(IsPointer)
-                                  .and_not(IsPOD) and
-                              (0 == initList.value()->getNumInits()))) {
+std::string EmitNoexceptMoveAudit()
+{
+    if(gMoveAuditRecords.empty()) {
+        return {};
+    }
 
-                    // Skip the init statement in case we have a class type with a trivial default-constructor which
-                    // is used for this initialization.
-                    if(not(ctorExpr and ctorExpr->getConstructor()->isDefaultConstructor() and
-                           ctorExpr->getConstructor()->getParent()->hasTrivialDefaultConstructor())) {
+    OutputFormatHelper ofm{};
+    ofm.AppendNewLine();
+    ofm.AppendCommentNewLine("Noexcept move audit:"sv);
+
+    for(const auto* record : gMoveAuditRecords) {
+        const auto [moveCtorState, noexceptMove] = GetMoveMemberState(record, false);
+        const auto moveAssignState               = GetMoveMemberState(record, true).first;
+
+        const auto type  = GetRecordDeclType(record);
+        const auto yesNo = [](bool b) { return ValueOr(b, "yes"sv, "no"sv); };
+
+        std::string line{StrCat(GetName(*record),
+                                ": move constructor: "sv,
+                                moveCtorState,
+                                ", move assignment: "sv,
+                                moveAssignState,
+                                ", trivially copyable: "sv,
+                                yesNo(type.isTriviallyCopyableType(GetGlobalAST())),
+                                ", trivially relocatable: "sv,
+                                yesNo(type.isTriviallyRelocatableType(GetGlobalAST())))};
+
+        if(const auto containers = GetStoringContainers(record); not containers.empty()) {
+            for(const auto& container : containers) {
+                line.append(StrCat(", stored in "sv, container.name));
+            }
 
-                        const bool isPrimaryTemplatePackExpansionExpr{
-                            IsPrimaryTemplatePackExpansionExpr(dyn_cast_or_null<ParenListExpr>(init))};
+            // std::move_if_noexcept only falls back to a copy, if there is one. A move-only type is moved anyway.
+            if(not noexceptMove and not type.isTriviallyCopyableType(GetGlobalAST()) and
+               ranges::any_of(containers, [](const auto& c) { return c.relocates; }) and IsCopyConstructible(record)) {
+                line.append(", reallocation copies instead of moves"sv);
+            }
+        }
 
-                        if(not isa<CXXParenListInitExpr>(init) and not isPrimaryTemplatePackExpansionExpr) {
-                            mOutputFormatHelper.Append(hlpAssing);
-                        }
+        ofm.AppendCommentNewLine(line);
+    }
 
-                        WrapInParensIfNeeded(isPrimaryTemplatePackExpansionExpr, [&] {
-                            if(GetInsightsOptions().ShowLifetime and init->isXValue() and
-                               stmt->getType()->isRValueReferenceType()) {
+    return ofm.GetString();
+}
+//-----------------------------------------------------------------------------
 
-                                if(GetInsightsOptions().UseShow2C) {
-                                    mOutputFormatHelper.Append("&");
-                                }
+/// \brief The variables with static storage duration of the TU for the static initialization report, see \ref
+/// EmitStaticInitReport.
+/*constinit*/ static SmallVector<const VarDecl*, 10> gStaticInitVars{};
+/// \brief The local statics which need a guard together with whether the guard is thread-safe.
+/*constinit*/ static SmallVector<std::pair<const VarDecl*, bool>, 10> gGuardedLocalStatics{};
+//-----------------------------------------------------------------------------
 
-                                InsertArg(StaticCast(stmt->getType(), init, false));
+static void PushStaticInitVar(const VarDecl* stmt)
+{
+    // Only the definition initializes the variable. Without an initializer it is zero-initialized, which costs
+    // nothing at start-up.
+    RETURN_IF(not stmt->hasGlobalStorage() or stmt->isStaticLocal() or stmt->getLocation().isInvalid() or
+              (VarDecl::Definition != stmt->isThisDeclarationADefinition()) or not stmt->getInit() or
+              stmt->getDeclContext()->isDependentContext() or stmt->getType()->isDependentType() or
+              stmt->getInit()->isValueDependent());
 
-                            } else {
-                                InsertArg(init);
-                            }
-                        });
-                    }
-                }
+    // The same definition can be generated more than once, report it once
+    RETURN_IF(ranges::any_of(gStaticInitVars,
+                             [&](const VarDecl* vd) { return vd->getCanonicalDecl() == stmt->getCanonicalDecl(); }));
+
+    gStaticInitVars.push_back(stmt);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Name what a dynamic initializer executes, a constructor or a function call.
+static std::string GetDynamicInitDescription(const Expr* init)
+{
+    init = init->IgnoreImplicit();
+
+    if(const auto* ctorExpr = dyn_cast_or_null<CXXConstructExpr>(init)) {
+        return StrCat("dynamic initialization by constructor "sv, GetName(*ctorExpr->getConstructor()->getParent()));
+
+    } else if(const auto* callExpr = dyn_cast_or_null<CallExpr>(init)) {
+        if(const auto* callee = callExpr->getDirectCallee()) {
+            return StrCat("dynamic initialization by call to "sv, GetName(*callee, QualifiedName::Yes));
+        }
+    }
+
+    return std::string{"dynamic initialization"sv};
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetStaticVarLocation(const VarDecl* stmt)
+{
+    return StrCat("line "sv, GetSM(*stmt).getSpellingLineNumber(stmt->getLocation()));
+}
+//-----------------------------------------------------------------------------
+
+std::string EmitStaticInitReport()
+{
+    if(gStaticInitVars.empty() and gGuardedLocalStatics.empty()) {
+        return {};
+    }
+
+    OutputFormatHelper ofm{};
+    ofm.AppendNewLine();
+    ofm.AppendCommentNewLine("Static initialization report:"sv);
+
+    const auto& ctx = GetGlobalAST();
+
+    auto hasNonTrivialDtor = [&](const VarDecl* vd) {
+        return QualType::DK_cxx_destructor == vd->needsDestruction(ctx);
+    };
+
+    for(const auto* vd : gStaticInitVars) {
+        const bool dynamicInit{vd->getInit() and not vd->hasConstantInitialization()};
+        const bool nonTrivialDtor{hasNonTrivialDtor(vd)};
+        const bool markedConstant{vd->isConstexpr() or vd->hasAttr<ConstInitAttr>()};
+
+        SmallVector<std::string, 4> findings{};
+
+        if(vd->getTLSKind()) {
+            findings.push_back(std::string{"thread_local, initialized per thread"sv});
+        }
+
+        if(dynamicInit) {
+            findings.push_back(GetDynamicInitDescription(vd->getInit()));
+
+            // Inline variables and static members of class templates may be initialized from multiple TUs
+            if(vd->isInline() or isTemplateInstantiation(vd->getTemplateSpecializationKind())) {
+                findings.push_back(std::string{"guard variable for vague linkage"sv});
             }
+
+        } else if(not markedConstant) {
+            const bool couldBeConstexpr{vd->getType().isConstQualified() and not nonTrivialDtor};
+            const auto keyword = ValueOr(couldBeConstexpr, "constexpr"sv, "constinit"sv);
+
+            findings.push_back(StrCat("constant initialization, could be "sv, keyword));
         }
 
-        if(stmt->isNRVOVariable()) {
-            mOutputFormatHelper.Append(" /* NRVO variable */"sv);
+        if(nonTrivialDtor) {
+            findings.push_back(std::string{"non-trivial destruction at exit"sv});
         }
 
-        if(InsertSemi()) {
-            mOutputFormatHelper.AppendSemiNewLine();
+        if(findings.empty()) {
+            continue;
         }
 
-        // Insert the bindings of a DecompositionDecl if this VarDecl is a DecompositionDecl.
-        if(const auto* decompDecl = dyn_cast_or_null<DecompositionDecl>(stmt)) {
-            StructuredBindingsCodeGenerator codeGenerator{mOutputFormatHelper, GetName(*stmt)};
+        ofm.AppendCommentNewLine(GetName(*vd, QualifiedName::Yes),
+                                 " ("sv,
+                                 GetStaticVarLocation(vd),
+                                 "): "sv,
+                                 llvm::join(findings, ", "sv));
+    }
 
-            codeGenerator.InsertDecompositionBindings(*decompDecl);
+    for(const auto& [vd, threadSafe] : gGuardedLocalStatics) {
+        std::string line{StrCat("local static "sv, GetName(*vd))};
+
+        if(const auto* func = dyn_cast_or_null<FunctionDecl>(vd->getParentFunctionOrMethod())) {
+            line.append(StrCat(" in "sv, GetName(*func, QualifiedName::Yes)));
         }
+
+        line.append(StrCat(" ("sv,
+                           GetStaticVarLocation(vd),
+                           "): "sv,
+                           ValueOr(threadSafe, "thread-safe guard"sv, "guard"sv),
+                           ", "sv,
+                           GetDynamicInitDescription(vd->getInit())));
+
+        if(hasNonTrivialDtor(vd)) {
+            line.append(", non-trivial destruction at exit"sv);
+        }
+
+        ofm.AppendCommentNewLine(line);
     }
 
-    if(needsGuard) {
-        mOutputFormatHelper.InsertEndIfTemplateGuard();
+    return ofm.GetString();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The code generated for the implicit instantiations of a template, see \ref EmitTemplateCostReport.
+struct TemplateCost
+{
+    const TemplateDecl* tmpl{};
+    uint64_t            instantiations{};
+    uint64_t            lines{};
+    uint64_t            bytes{};
+};
+
+/*constinit*/ static SmallVector<TemplateCost, 10> gTemplateCosts{};
+//-----------------------------------------------------------------------------
+
+static void PushTemplateCost(const TemplateDecl* tmpl, std::string_view generated)
+{
+    const uint64_t lines = ranges::count(generated, '\n');
+
+    if(auto iter = ranges::find_if(gTemplateCosts, [&](const auto& e) { return e.tmpl == tmpl; });
+       iter != gTemplateCosts.end()) {
+        ++iter->instantiations;
+        iter->lines += lines;
+        iter->bytes += generated.size();
+    } else {
+        gTemplateCosts.push_back({tmpl, 1, lines, generated.size()});
     }
 }
 //-----------------------------------------------------------------------------
 
-bool CodeGenerator::InsertLambdaStaticInvoker(const CXXMethodDecl* cxxMethodDecl)
+static std::string_view GetTemplateKindName(const TemplateDecl* tmpl)
 {
-    if(not(cxxMethodDecl and cxxMethodDecl->isLambdaStaticInvoker())) {
-        return false;
+    if(isa<FunctionTemplateDecl>(tmpl)) {
+        return "function template"sv;
+    } else if(isa<VarTemplateDecl>(tmpl)) {
+        return "variable template"sv;
     }
 
-    // A special case for a lambda with a static invoker. The standard says, that in such a case invoking the call
-    // operator gives the same result as invoking the function pointer (see [expr.prim.lambda.closure] p9). When it
-    // comes to block local statics having a body for both functions reveals a difference. This special code
-    // generates a forwarding call from the call operator to the static invoker. However, the compiler does better
-    // here. As this way we end up with copies of the parameters which is hard to avoid.
+    return "class template"sv;
+}
+//-----------------------------------------------------------------------------
 
-    mOutputFormatHelper.AppendNewLine();
-    mOutputFormatHelper.OpenScope();
+std::string EmitTemplateCostReport()
+{
+    if(gTemplateCosts.empty()) {
+        return {};
+    }
 
-    if(not cxxMethodDecl->getReturnType()->isVoidType()) {
-        mOutputFormatHelper.Append(kwReturn, " "sv);
+    OutputFormatHelper ofm{};
+
+    // Rank the templates by the amount of generated code and then by the number of instantiations
+    ranges::stable_sort(gTemplateCosts, [](const auto& a, const auto& b) {
+        return std::tie(a.bytes, a.instantiations) > std::tie(b.bytes, b.instantiations);
+    });
+
+    ofm.AppendNewLine();
+    ofm.AppendCommentNewLine("Template instantiation costs:"sv);
+
+    for(const auto& e : gTemplateCosts) {
+        ofm.AppendCommentNewLine(GetTemplateKindName(e.tmpl),
+                                 " "sv,
+                                 GetName(*e.tmpl, QualifiedName::Yes),
+                                 ": instantiations: "sv,
+                                 e.instantiations,
+                                 ", lines: "sv,
+                                 e.lines,
+                                 ", bytes: "sv,
+                                 e.bytes);
     }
 
-    mOutputFormatHelper.Append(GetName(*cxxMethodDecl->getParent()), "{}.operator()"sv);
+    return ofm.GetString();
+}
+//-----------------------------------------------------------------------------
 
-    if(cxxMethodDecl->isFunctionTemplateSpecialization()) {
-        InsertTemplateArgs(*dyn_cast_or_null<FunctionDecl>(cxxMethodDecl));
+/// \brief The fingerprint of the code generated for an implicit instantiation, see \ref EmitICFCandidates.
+struct InstantiationFingerprint
+{
+    const TemplateDecl* tmpl{};
+    std::string         name{};
+    llvm::hash_code     hash{};
+    uint64_t            bytes{};
+};
+
+/*constinit*/ static SmallVector<InstantiationFingerprint, 10> gInstantiationFingerprints{};
+//-----------------------------------------------------------------------------
+
+static ArrayRef<TemplateArgument> GetSpecializationArgs(const Decl* spec)
+{
+    if(const auto* clsSpec = dyn_cast_or_null<ClassTemplateSpecializationDecl>(spec)) {
+        return clsSpec->getTemplateArgs().asArray();
+
+    } else if(const auto* varSpec = dyn_cast_or_null<VarTemplateSpecializationDecl>(spec)) {
+        return varSpec->getTemplateArgs().asArray();
+
+    } else if(const auto* funcSpec = dyn_cast_or_null<FunctionDecl>(spec)) {
+        if(const auto* args = funcSpec->getTemplateSpecializationArgs()) {
+            return args->asArray();
+        }
     }
 
-    if(cxxMethodDecl->isTemplated()) {
-        if(cxxMethodDecl->getDescribedTemplate()) {
-            InsertTemplateParameters(*cxxMethodDecl->getDescribedTemplate()->getTemplateParameters(),
-                                     TemplateParamsOnly::Yes);
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Replace each occurrence of the type name \p name in \p text which is not part of a longer identifier.
+static void ReplaceTypeName(std::string& text, std::string_view name, std::string_view replacement)
+{
+    auto isIdentifierChar = [](char c) { return llvm::isAlnum(c) or ('_' == c); };
+
+    for(size_t pos = text.find(name); std::string::npos != pos; pos = text.find(name, pos)) {
+        const size_t end = pos + name.size();
+        const bool   startsToken{(0 == pos) or not isIdentifierChar(text[pos - 1]) or
+                               not isIdentifierChar(name.front())};
+        const bool   endsToken{(text.size() == end) or not isIdentifierChar(text[end]) or
+                             not isIdentifierChar(name.back())};
+
+        if(startsToken and endsToken) {
+            text.replace(pos, name.size(), replacement);
+            pos += replacement.size();
+        } else {
+            ++pos;
         }
-        /*else if(decl.isFunctionTemplateSpecialization()) {
-            InsertTemplateSpecializationHeader();
-        }*/
     }
+}
+//-----------------------------------------------------------------------------
 
-    WrapInParens([&] {
-        mOutputFormatHelper.AppendParameterList(cxxMethodDecl->parameters(),
-                                                OutputFormatHelper::NameOnly::Yes,
-                                                OutputFormatHelper::GenMissingParamName::Yes);
-    });
+/// \brief The kind of \p type for identical code folding, which together with size and alignment forms its class.
+///
+/// An integer and a floating point type of the same size still compile to different instructions. A class which is not
+/// trivially copyable has no kind, its special members differ by type.
+static std::optional<std::string_view> GetICFTypeKind(QualType type)
+{
+    if(type->isSignedIntegerOrEnumerationType()) {
+        return "sint"sv;
+    } else if(type->isUnsignedIntegerOrEnumerationType()) {
+        return "uint"sv;
+    } else if(type->isRealFloatingType()) {
+        return "float"sv;
+    } else if(type->isAnyPointerType()) {
+        return "ptr"sv;
+    } else if(type->isRecordType() and type.isTriviallyCopyableType(GetGlobalAST())) {
+        return "record"sv;
+    }
 
-    mOutputFormatHelper.AppendSemiNewLine();
-    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
-    mOutputFormatHelper.AppendNewLine();
+    return {};
+}
+//-----------------------------------------------------------------------------
 
-    return true;
+/// \brief Hash the generated code of an instantiation with the type arguments replaced by their kind, size and
+/// alignment, see \ref GetICFTypeKind.
+///
+/// Two instantiations with the same hash, like the ones for \c int* and \c long*, are candidates for identical code
+/// folding.
+static void PushInstantiationFingerprint(const TemplateDecl* tmpl, const Decl* spec, std::string_view generated)
+{
+    const auto args = GetSpecializationArgs(spec);
+    RETURN_IF(args.empty());
+
+    const auto& ctx = GetGlobalAST();
+    std::string normalized{};
+
+    // The point of instantiation differs for each instantiation
+    for(const auto& line : llvm::split(generated, '\n')) {
+        if(not line.starts_with("/* First instantiated from:"sv)) {
+            normalized.append(StrCat(line, "\n"sv));
+        }
+    }
+
+    SmallVector<std::pair<std::string, std::string>, 4> typeNames{};
+
+    for(const auto& arg : args) {
+        if(TemplateArgument::Type != arg.getKind()) {
+            continue;
+        }
+
+        const auto type = arg.getAsType();
+
+        if(type->isDependentType() or type->isIncompleteType() or type->isFunctionType()) {
+            continue;
+        }
+
+        const auto kind = GetICFTypeKind(type);
+
+        if(not kind.has_value()) {
+            continue;
+        }
+
+        const auto typeInfo = ctx.getTypeInfoInChars(type);
+        typeNames.emplace_back(GetName(type),
+                               StrCat("__"sv,
+                                      kind.value(),
+                                      "_size"sv,
+                                      typeInfo.Width.getQuantity(),
+                                      "_align"sv,
+                                      typeInfo.Align.getQuantity()));
+    }
+
+    // Longer names first so that for example `unsigned int` is replaced before `int`
+    ranges::stable_sort(typeNames, [](const auto& a, const auto& b) { return a.first.size() > b.first.size(); });
+
+    for(const auto& [name, sizeClass] : typeNames) {
+        ReplaceTypeName(normalized, name, sizeClass);
+    }
+
+    OutputFormatHelper   ofm{};
+    CodeGeneratorVariant cg{ofm};
+    cg->InsertTemplateArgs(args);
+
+    gInstantiationFingerprints.push_back(
+        {tmpl, StrCat(GetName(*tmpl), ofm.GetString()), llvm::hash_value(normalized), generated.size()});
 }
 //-----------------------------------------------------------------------------
 
-/// \brief Inserts the instantiation point of a template.
-//
-// This reveals at which place the template is first used.
-void CodeGenerator::InsertInstantiationPoint(const SourceManager&  sm,
-                                             const SourceLocation& instLoc,
-                                             std::string_view      text)
+std::string EmitICFCandidates()
 {
-    const auto  lineNo = sm.getSpellingLineNumber(instLoc);
-    const auto& fileId = sm.getFileID(instLoc);
-    if(const auto file = sm.getFileEntryRefForID(fileId)) {
-        const auto fileWithDirName = file->getName();
-        const auto fileName        = llvm::sys::path::filename(fileWithDirName);
+    struct ICFGroup
+    {
+        std::string names{};
+        uint64_t    duplicatedBytes{};
+    };
 
-        if(text.empty()) {
-            text = "First instantiated from: "sv;
+    SmallVector<ICFGroup, 8> groups{};
+    SmallVector<bool, 16>    grouped(gInstantiationFingerprints.size(), false);
+
+    for(size_t i = 0; i < gInstantiationFingerprints.size(); ++i) {
+        if(grouped[i]) {
+            continue;
         }
 
-        mOutputFormatHelper.AppendCommentNewLine(text, fileName, ":"sv, lineNo);
+        const auto& first = gInstantiationFingerprints[i];
+        ICFGroup    group{first.name};
+
+        for(size_t j = i + 1; j < gInstantiationFingerprints.size(); ++j) {
+            const auto& other = gInstantiationFingerprints[j];
+
+            if(not grouped[j] and (other.tmpl == first.tmpl) and (other.hash == first.hash)) {
+                grouped[j] = true;
+                group.names.append(StrCat(", "sv, other.name));
+                group.duplicatedBytes += other.bytes;
+            }
+        }
+
+        if(0 != group.duplicatedBytes) {
+            groups.push_back(std::move(group));
+        }
+    }
+
+    if(groups.empty()) {
+        return {};
+    }
+
+    ranges::stable_sort(groups, [](const auto& a, const auto& b) { return a.duplicatedBytes > b.duplicatedBytes; });
+
+    OutputFormatHelper ofm{};
+    ofm.AppendNewLine();
+    ofm.AppendCommentNewLine("Identical code folding candidates:"sv);
+
+    for(const auto& group : groups) {
+        ofm.AppendCommentNewLine(group.names, ": duplicated bytes: "sv, group.duplicatedBytes);
     }
+
+    return ofm.GetString();
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertTemplateGuardBegin(const FunctionDecl* stmt)
+void CodeGenerator::InsertTemplateSpecialization(const TemplateDecl* tmpl, const Decl* spec, void_func_ref insert)
 {
-    if(stmt->isTemplateInstantiation() and stmt->isFunctionTemplateSpecialization()) {
-        InsertInstantiationPoint(GetSM(*stmt), stmt->getPointOfInstantiation());
-        mOutputFormatHelper.InsertIfDefTemplateGuard();
+    const auto start = mOutputFormatHelper.CurrentPos();
+
+    insert();
+
+    RETURN_IF(mOutputFormatHelper.CurrentPos() < start);
+
+    const auto generated = std::string_view{mOutputFormatHelper.GetString()}.substr(start);
+
+    if(GetInsightsOptions().ShowTemplateCosts) {
+        PushTemplateCost(tmpl, generated);
+    }
+
+    if(GetInsightsOptions().ShowICFCandidates) {
+        PushInstantiationFingerprint(tmpl, spec, generated);
     }
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertTemplateGuardEnd(const FunctionDecl* stmt)
+/// \brief The keys of the declarations the file of \c -shared-output holds, as far as this run read it.
+static llvm::StringSet<>                     gSharedDecls{};
+static std::unique_ptr<llvm::raw_fd_ostream> gSharedOutput{};
+static int                                   gSharedOutputFd{-1};
+static std::string                           gSharedOutputPath{};
+static uint64_t                              gSharedOutputRead{};  //!< The part of the file \ref gSharedDecls covers.
+static bool                                  gInSharedDecl{};  //!< A shared declaration is generated right now.
+static constexpr std::string_view            gSharedDeclPrefix{"// insights-shared: "sv};
+//-----------------------------------------------------------------------------
+
+/// \brief Take over the declarations other runs appended to the file of \c -shared-output since the last call.
+///
+/// Only call it with the file locked, the other runs append whole declarations only while they hold the lock.
+static void ReadSharedDecls()
 {
-    if(stmt->isTemplateInstantiation() and stmt->isFunctionTemplateSpecialization()) {
-        mOutputFormatHelper.InsertEndIfTemplateGuard();
+    llvm::sys::fs::file_status status{};
+    RETURN_IF(llvm::sys::fs::status(gSharedOutputFd, status) or (status.getSize() <= gSharedOutputRead));
+
+    const auto size   = status.getSize() - gSharedOutputRead;
+    auto       buffer = llvm::MemoryBuffer::getOpenFileSlice(
+        llvm::sys::fs::convertFDToNativeFile(gSharedOutputFd), gSharedOutputPath, size, gSharedOutputRead);
+    RETURN_IF(not buffer);
+
+    SmallVector<StringRef, 64> lines{};
+    (*buffer)->getBuffer().split(lines, '\n');
+
+    for(auto line : lines) {
+        if(line.consume_front(gSharedDeclPrefix)) {
+            gSharedDecls.insert(line);
+        }
+    }
+
+    gSharedOutputRead += size;
+}
+//-----------------------------------------------------------------------------
+
+bool OpenSharedOutput(StringRef path)
+{
+    gSharedDecls.clear();
+    gSharedOutput.reset();
+    gSharedOutputPath = path.str();
+    gSharedOutputRead = 0;
+
+    if(llvm::sys::fs::openFileForReadWrite(
+           path, gSharedOutputFd, llvm::sys::fs::CD_OpenAlways, llvm::sys::fs::OF_Append)) {
+        return false;
+    }
+
+    gSharedOutput = std::make_unique<llvm::raw_fd_ostream>(gSharedOutputFd, true);
+
+    // Take over the declarations earlier runs stored
+    if(not llvm::sys::fs::lockFile(gSharedOutputFd)) {
+        ReadSharedDecls();
+        (void)llvm::sys::fs::unlockFile(gSharedOutputFd);
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Append the generated \p code of a shared declaration to the file of \c -shared-output, unless another run
+/// already did.
+///
+/// Several processes can use the same file. The lock lets only one at a time check for the key and append.
+///
+/// \returns False, if the declaration could not be stored.
+static bool WriteSharedDecl(StringRef key, StringRef code)
+{
+    if(llvm::sys::fs::lockFile(gSharedOutputFd)) {
+        return false;
+    }
+
+    ReadSharedDecls();
+
+    bool stored{true};
+
+    if(not gSharedDecls.contains(key)) {
+        *gSharedOutput << gSharedDeclPrefix << key << '\n' << code << '\n';
+        gSharedOutput->flush();
+
+        // Only a declaration which made it into the file can be referred to
+        if(gSharedOutput->has_error()) {
+            gSharedOutput->clear_error();
+            stored = false;
+
+        } else {
+            gSharedDecls.insert(key);
+        }
+    }
+
+    (void)llvm::sys::fs::unlockFile(gSharedOutputFd);
+
+    return stored;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Append what the generated code depends on besides the declaration, the options and the standard, to \p data.
+static void AppendSharedConfiguration(std::string& data)
+{
+    data.append(StrCat("std:"sv, static_cast<int>(GetGlobalAST().getLangOpts().LangStd), ";opts:"sv));
+
+#define INSIGHTS_OPT(option, member, deflt, description, category)                                                    \
+    data.push_back(GetInsightsOptions().member ? '1' : '0');
+
+#include "InsightsOptions.def"
+
+    data.append(StrCat(";sbo:"sv, GetInsightsOptions().LambdaSBOSize));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief A key which is the same for a header declaration in each translation unit it generates equally in.
+///
+/// The ODR hash covers what is written. The output of a class also contains the implicit members a translation unit
+/// uses, they become part of the key. So do the options and the standard, see \ref AppendSharedConfiguration.
+/// Templates contain the instantiations of a translation unit and are never shared. Other processes compare the key,
+/// so it is hashed with xxh3, \c llvm::hash_code may differ between executions.
+static std::optional<std::string> GetSharedDeclKey(const Decl* decl)
+{
+    if(not decl->getDeclContext()->getRedeclContext()->isFileContext()) {
+        return {};
+    }
+
+    const auto& sm           = GetGlobalAST().getSourceManager();
+    const auto  expansionLoc = sm.getExpansionLoc(decl->getLocation());
+
+    if(expansionLoc.isInvalid() or sm.isInMainFile(expansionLoc)) {
+        return {};
+    }
+
+    std::string data{};
+
+    if(const auto* record = dyn_cast_or_null<CXXRecordDecl>(decl);
+       record and record->isThisDeclarationADefinition() and not record->getDescribedClassTemplate() and
+       not isa<ClassTemplateSpecializationDecl>(record)) {
+        data = StrCat("odr:"sv, record->getODRHash());
+
+        for(const auto* member : record->decls()) {
+            if(const auto* namedMember = dyn_cast_or_null<NamedDecl>(member);
+               namedMember and namedMember->isImplicit() and namedMember->isUsed()) {
+                data.append(StrCat(";implicit:"sv,
+                                   static_cast<int>(namedMember->getKind()),
+                                   " "sv,
+                                   namedMember->getNameAsString()));
+            }
+        }
+
+    } else if(const auto* func = dyn_cast_or_null<FunctionDecl>(decl);
+              func and func->doesThisDeclarationHaveABody() and
+              (FunctionDecl::TK_NonTemplate == func->getTemplatedKind())) {
+        data = StrCat("odr:"sv, const_cast<FunctionDecl*>(func)->getODRHash());
+
+    } else if(const auto* enumDecl = dyn_cast_or_null<EnumDecl>(decl);
+              enumDecl and enumDecl->isThisDeclarationADefinition()) {
+        data = StrCat("odr:"sv, const_cast<EnumDecl*>(enumDecl)->getODRHash());
+
+    } else {
+        return {};
+    }
+
+    data.push_back(';');
+    AppendSharedConfiguration(data);
+
+    return StrCat(decl->getDeclKindName(),
+                  " "sv,
+                  GetName(*cast<NamedDecl>(decl), QualifiedName::Yes),
+                  " "sv,
+                  llvm::utohexstr(llvm::xxh3_64bits(llvm::arrayRefFromStringRef(data))));
+}
+//-----------------------------------------------------------------------------
+
+bool CodeGenerator::InsertSharedDecl(const Decl* decl)
+{
+    if(not gSharedOutput or gInSharedDecl) {
+        return false;
+    }
+
+    const auto key = GetSharedDeclKey(decl);
+
+    if(not key.has_value()) {
+        return false;
+    }
+
+    if(not gSharedDecls.contains(key.value())) {
+        OutputFormatHelper   outputFormatHelper{};
+        CodeGeneratorVariant codeGenerator{outputFormatHelper};
+
+        gInSharedDecl = true;
+        codeGenerator->InsertArg(decl);
+        gInSharedDecl = false;
+
+        // Generate it in place instead
+        if(not WriteSharedDecl(key.value(), outputFormatHelper.GetString())) {
+            return false;
+        }
+    }
+
+    mOutputFormatHelper.AppendCommentNewLine("Shared: "sv, key.value());
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+std::string EmitGlobalVariableCtors()
+{
+    StmtsContainer bodyStmts{};
+
+    for(auto& e : globalVarCtors) {
+        bodyStmts.AddBodyStmts(e);
+    }
+
+    auto* cxaStartFun = Function(cxaStart, VoidTy(), {});
+    cxaStartFun->setBody(mkCompoundStmt(bodyStmts));
+
+    OutputFormatHelper ofm{};
+    ofm.AppendNewLine();
+    ofm.AppendNewLine();
+    CodeGeneratorVariant cg{ofm};
+
+    if(gVtables.size()) {
+        SmallVector<Expr*, 16> mInitExprs{};
+
+        for(auto& e : gVtables) {
+            cg->InsertArg(e.second);
+            mInitExprs.push_back(mkDeclRefExpr(e.second));
+        }
+
+        ofm.AppendNewLine();
+
+        // struct __mptr *__ptbl_vec__c___src_C_[]
+        auto* vtable = CfrontCodeGenerator::VtableData().VtblArrayVar(mInitExprs.size());
+        vtable->setInit(InitList(mInitExprs, vtable->getType()));
+
+        cg->InsertArg(vtable);
+
+        ofm.AppendNewLine();
+    }
+
+    cg->InsertArg(cxaStartFun);
+
+    StmtsContainer bodyStmtsDtors{};
+
+    for(auto& e : globalVarDtors) {
+        bodyStmtsDtors.AddBodyStmts(e);
+    }
+
+    auto* cxaAtExitFun = Function(cxaAtExit, VoidTy(), {});
+    cxaAtExitFun->setBody(mkCompoundStmt(bodyStmtsDtors));
+
+    ofm.AppendNewLine();
+    cg->InsertArg(cxaAtExitFun);
+
+    return ofm.GetString();
+}
+//-----------------------------------------------------------------------------
+
+void ResetGeneratorState()
+{
+    gVtables.clear();
+    globalVarCtors.clear();
+    globalVarDtors.clear();
+    gCostlyImplicitCasts.clear();
+    gMoveAuditRecords.clear();
+    gStaticInitVars.clear();
+    gGuardedLocalStatics.clear();
+    gTemplateCosts.clear();
+    gInstantiationFingerprints.clear();
+
+    CfrontCodeGenerator::ResetState();
+    CoroutinesCodeGenerator::ResetState();
+    RestoreReplacedNodes();
+
+    // Only a crashed transformation leaves these behind
+    ScopeHandler::Reset();
+    LifetimeTracker::Reset();
+    CodeGenerator::ResetFunctionReport();
+    gInSharedDecl = false;
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::LifetimeAddExtended(const VarDecl* vd, const ValueDecl* extending)
+{
+    mLifeTimeTracker.AddExtended(vd, extending);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::StartLifetimeScope()
+{
+    mLifeTimeTracker.StartScope(false);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::EndLifetimeScope()
+{
+    mSkipSemi = mLifeTimeTracker.EndScope(mOutputFormatHelper, false) or mSkipSemi;
+}
+//-----------------------------------------------------------------------------
+
+// In a primary template we can see a ParenListExpr with a PackExpansionExpr. With the equal sign we need a type.
+static bool IsPrimaryTemplatePackExpansionExpr(const ParenListExpr* stmt)
+{
+    return stmt and stmt->getNumExprs() and isa_and_nonnull<PackExpansionExpr>(stmt->getExpr(0)) and
+           stmt->getType().isNull();
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const LinkageSpecDecl* stmt)
+{
+    mOutputFormatHelper.Append("extern \"",
+                               (
+#if IS_CLANG_NEWER_THAN(17)
+                                   LinkageSpecLanguageIDs::C
+#else
+                                   LinkageSpecDecl::lang_c
+#endif
+                                   == stmt->getLanguage())
+                                   ? "C"sv
+                                   : "C++"sv,
+                               "\"");
+    mOutputFormatHelper.OpenScope();
+
+    for(const auto* decl : stmt->decls()) {
+        InsertArg(decl);
+    }
+
+    mOutputFormatHelper.CloseScope();
+    mOutputFormatHelper.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const VarDecl* stmt)
+{
+    if(auto* init = stmt->getInit();
+       GetInsightsOptions().UseShow2C and IsReferenceType(stmt) and
+       (not(isa<CallExpr>(init) or
+            (isa<ExprWithCleanups>(init) and
+             (isa<CallExpr>(dyn_cast_or_null<ExprWithCleanups>(init)->getSubExpr()) or
+              isa<MaterializeTemporaryExpr>(dyn_cast_or_null<ExprWithCleanups>(init)->getSubExpr())))))) {
+        return;
+    }
+
+    mLifeTimeTracker.Add(stmt);
+
+    // If this is part of a DecompositionDecl then ignore this VarDecl as we already have seen and inserted it. This
+    // happens in StructuredBindingsHandler3Test.cpp
+    if(BindingDeclFinder isBindingDecl{}; isBindingDecl.Find(stmt->getInit())) {
+        return;
+    }
+
+    LAMBDA_SCOPE_HELPER(VarDecl);
+    UpdateCurrentPos(mCurrentVarDeclPos);
+
+    TemporaryDeclFinder temporaryFinder{*this, stmt->getInit()};
+
+    if(InsertComma()) {
+        mOutputFormatHelper.Append(',');
+    }
+
+    // If we are looking at a static member variable of a class template which is defined out-of-line we need to
+    // protect the resulting instantiations.
+    const bool needsGuard = stmt->isOutOfLine() and isTemplateInstantiation(stmt->getTemplateSpecializationKind());
+
+    // We are looking at the primary definition of a out-of-line member variable of a class template. We need to add
+    // the template head.
+    if(stmt->isOutOfLine()) {
+        if(const auto* recordDecl = dyn_cast_or_null<CXXRecordDecl>(stmt->getDeclContext())) {
+            if(const auto* classTmpl = recordDecl->getDescribedClassTemplate()) {
+                InsertTemplateParameters(*classTmpl->getTemplateParameters());
+            }
+        }
+    }
+
+    if(isa<VarTemplateSpecializationDecl>(stmt)) {
+        InsertTemplateSpecializationHeader();
+    } else if(needsGuard) {
+        mOutputFormatHelper.InsertIfDefTemplateGuard();
+    }
+
+    InsertAttributes(stmt->attrs());
+    InsertConceptConstraint(stmt);
+
+    if(GetInsightsOptions().ShowStaticInit) {
+        PushStaticInitVar(stmt);
+    }
+
+    if(IsTrivialStaticClassVarDecl(*stmt)) {
+        HandleLocalStaticNonTrivialClass(stmt);
+
+    } else {
+        if(InsertVarDecl(stmt)) {
+            const auto desugaredType = GetType(GetDesugarType(stmt->getType()));
+
+            const bool isMemberPointer{isa<MemberPointerType>(desugaredType.getTypePtrOrNull())};
+            if(desugaredType->isFunctionPointerType() or isMemberPointer) {
+                const auto lineNo    = GetSM(*stmt).getSpellingLineNumber(stmt->getSourceRange().getBegin());
+                const auto ptrPrefix = isMemberPointer ? memberVariablePointerPrefix : functionPointerPrefix;
+                const auto funcPtrName{StrCat(ptrPrefix, lineNo)};
+
+                mOutputFormatHelper.AppendSemiNewLine(kwUsingSpace, funcPtrName, hlpAssing, GetName(desugaredType));
+                mOutputFormatHelper.Append(GetQualifiers(*stmt), funcPtrName, " "sv, GetName(*stmt));
+
+            } else {
+                mOutputFormatHelper.Append(GetQualifiers(*stmt));
+
+                const auto scope = [&] {
+                    if(const auto* ctx = stmt->getDeclContext(); stmt->getLexicalDeclContext() != ctx) {
+                        OutputFormatHelper scopeOfm{};
+                        scopeOfm.Append(GetDeclContext(ctx, WithTemplateParameters::Yes));
+
+                        return ScopeHandler::RemoveCurrentScope(scopeOfm.GetString());
+                    }
+
+                    return std::string{};
+                }();
+
+                const auto varName = FormatVarTemplateSpecializationDecl(stmt, StrCat(scope, GetName(*stmt)));
+
+                // TODO: to keep the special handling for lambdas, do this only for template specializations
+                mOutputFormatHelper.Append(GetTypeNameAsParameter(GetType(stmt->getType()), varName));
+            }
+        } else {
+            const std::string_view pointer = [&]() {
+                if(SkipSpaceAfterVarDecl()) {
+                    return ""sv;
+                }
+
+                if(stmt->getType()->isAnyPointerType()) {
+                    return " *"sv;
+                }
+                return " "sv;
+            }();
+
+            mOutputFormatHelper.Append(pointer, GetName(*stmt));
+        }
+
+        if(const auto* init = stmt->getInit()) {
+            if(const auto* ctorExpr = dyn_cast_or_null<CXXConstructExpr>(init);
+               GetInsightsOptions().UseShow2C and ctorExpr) {
+
+                // https://stackoverflow.com/questions/45471470/how-to-generate-code-for-initializing-global-variables-with-non-const-values-in
+                // https://llvm.org/docs/LangRef.html#the-llvm-global-ctors-global-variable
+                // https://stackoverflow.com/questions/72971935/why-does-clang-do-thread-safe-init-for-some-globals-but-not-others
+                // __cxx_global_var_init
+                // https://discourse.llvm.org/t/static-constructors-cxx-global-var-initn-vs-global-sub-i-xxx/39442
+                //                if(stmt->needsDestruction(stmt->getASTContext())) {
+                //
+                // at_exit
+                // https://clang.llvm.org/doxygen/CGDeclCXX_8cpp_source.html
+                // __cxa_atexit
+
+                //                if(not ctorExpr->getConstructor()->isTrivial()) {
+                if(stmt->hasGlobalStorage()) {
+                    // push to __cxx_global_var_init
+                    auto* callExpr = CallConstructor(
+                        stmt->getType(), stmt, ArgsToExprVector(ctorExpr), DoCast::No, AsReference::Yes);
+
+                    PushGlobalVariable(callExpr);
+
+                    PushGlobalVariableDtor(CallDestructor(stmt));
+
+                } else {
+                    mOutputFormatHelper.AppendSemiNewLine();
+                    InsertArg(init);
+                }
+                //                }
+
+            } else {
+                mProcessingVarDecl = false;
+                BackupAndRestore _{mProcessingVarDecl, true};
+
+                if(MyOptional<const InitListExpr*> initList{dyn_cast_or_null<InitListExpr>(init)};
+                   GetInsightsOptions().UseShow2C and
+                   initList.and_then(CanonicalType).and_then(Isa<RecordType>).and_not(IsPointer).and_then(IsPOD) and
+                   not isa<ArrayType>(stmt->getType())) {
+                    auto* callMemset = Call("memset"sv, {Ref(stmt), Int32(0), Sizeof(stmt->getType())});
+
+                    EnableGlobalInsert(GlobalInserts::FuncMemset);
+
+                    if(stmt->hasGlobalStorage()) {
+                        PushGlobalVariable(callMemset);
+
+                    } else {
+                        mOutputFormatHelper.AppendSemiNewLine();
+                        InsertArg(callMemset);
+                    }
+
+                } else if(not(GetInsightsOptions().UseShow2C and
+                              initList.and_then(CanonicalType)
+                                  .and_then(Isa<RecordType>)
+                                  .and_not(IsPointer)
+                                  .and_not(IsPOD) and
+                              (0 == initList.value()->getNumInits()))) {
+
+                    // Skip the init statement in case we have a class type with a trivial default-constructor which
+                    // is used for this initialization.
+                    if(not(ctorExpr and ctorExpr->getConstructor()->isDefaultConstructor() and
+                           ctorExpr->getConstructor()->getParent()->hasTrivialDefaultConstructor())) {
+
+                        const bool isPrimaryTemplatePackExpansionExpr{
+                            IsPrimaryTemplatePackExpansionExpr(dyn_cast_or_null<ParenListExpr>(init))};
+
+                        if(not isa<CXXParenListInitExpr>(init) and not isPrimaryTemplatePackExpansionExpr) {
+                            mOutputFormatHelper.Append(hlpAssing);
+                        }
+
+                        WrapInParensIfNeeded(isPrimaryTemplatePackExpansionExpr, [&] {
+                            if(GetInsightsOptions().ShowLifetime and init->isXValue() and
+                               stmt->getType()->isRValueReferenceType()) {
+
+                                if(GetInsightsOptions().UseShow2C) {
+                                    mOutputFormatHelper.Append("&");
+                                }
+
+                                InsertArg(StaticCast(stmt->getType(), init, false));
+
+                            } else {
+                                InsertArg(init);
+                            }
+                        });
+                    }
+                }
+            }
+        }
+
+        if(stmt->isNRVOVariable()) {
+            mOutputFormatHelper.Append(" /* NRVO variable */"sv);
+        }
+
+        if(InsertSemi()) {
+            mOutputFormatHelper.AppendSemiNewLine();
+        }
+
+        // Insert the bindings of a DecompositionDecl if this VarDecl is a DecompositionDecl.
+        if(const auto* decompDecl = dyn_cast_or_null<DecompositionDecl>(stmt)) {
+            StructuredBindingsCodeGenerator codeGenerator{mOutputFormatHelper, GetName(*stmt)};
+
+            codeGenerator.InsertDecompositionBindings(*decompDecl);
+        }
+    }
+
+    if(needsGuard) {
+        mOutputFormatHelper.InsertEndIfTemplateGuard();
+    }
+}
+//-----------------------------------------------------------------------------
+
+bool CodeGenerator::InsertLambdaStaticInvoker(const CXXMethodDecl* cxxMethodDecl)
+{
+    if(not(cxxMethodDecl and cxxMethodDecl->isLambdaStaticInvoker())) {
+        return false;
+    }
+
+    // A special case for a lambda with a static invoker. The standard says, that in such a case invoking the call
+    // operator gives the same result as invoking the function pointer (see [expr.prim.lambda.closure] p9). When it
+    // comes to block local statics having a body for both functions reveals a difference. This special code
+    // generates a forwarding call from the call operator to the static invoker. However, the compiler does better
+    // here. As this way we end up with copies of the parameters which is hard to avoid.
+
+    mOutputFormatHelper.AppendNewLine();
+    mOutputFormatHelper.OpenScope();
+
+    if(not cxxMethodDecl->getReturnType()->isVoidType()) {
+        mOutputFormatHelper.Append(kwReturn, " "sv);
+    }
+
+    mOutputFormatHelper.Append(GetName(*cxxMethodDecl->getParent()), "{}.operator()"sv);
+
+    if(cxxMethodDecl->isFunctionTemplateSpecialization()) {
+        InsertTemplateArgs(*dyn_cast_or_null<FunctionDecl>(cxxMethodDecl));
+    }
+
+    if(cxxMethodDecl->isTemplated()) {
+        if(cxxMethodDecl->getDescribedTemplate()) {
+            InsertTemplateParameters(*cxxMethodDecl->getDescribedTemplate()->getTemplateParameters(),
+                                     TemplateParamsOnly::Yes);
+        }
+        /*else if(decl.isFunctionTemplateSpecialization()) {
+            InsertTemplateSpecializationHeader();
+        }*/
+    }
+
+    WrapInParens([&] {
+        mOutputFormatHelper.AppendParameterList(cxxMethodDecl->parameters(),
+                                                OutputFormatHelper::NameOnly::Yes,
+                                                OutputFormatHelper::GenMissingParamName::Yes);
+    });
+
+    mOutputFormatHelper.AppendSemiNewLine();
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+    mOutputFormatHelper.AppendNewLine();
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Inserts the instantiation point of a template.
+//
+// This reveals at which place the template is first used.
+void CodeGenerator::InsertInstantiationPoint(const SourceManager&  sm,
+                                             const SourceLocation& instLoc,
+                                             std::string_view      text)
+{
+    const auto  lineNo = sm.getSpellingLineNumber(instLoc);
+    const auto& fileId = sm.getFileID(instLoc);
+    if(const auto file = sm.getFileEntryRefForID(fileId)) {
+        const auto fileWithDirName = file->getName();
+        const auto fileName        = llvm::sys::path::filename(fileWithDirName);
+
+        if(text.empty()) {
+            text = "First instantiated from: "sv;
+        }
+
+        mOutputFormatHelper.AppendCommentNewLine(text, fileName, ":"sv, lineNo);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertTemplateGuardBegin(const FunctionDecl* stmt)
+{
+    if(stmt->isTemplateInstantiation() and stmt->isFunctionTemplateSpecialization()) {
+        InsertInstantiationPoint(GetSM(*stmt), stmt->getPointOfInstantiation());
+        mOutputFormatHelper.InsertIfDefTemplateGuard();
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertTemplateGuardEnd(const FunctionDecl* stmt)
+{
+    if(stmt->isTemplateInstantiation() and stmt->isFunctionTemplateSpecialization()) {
+        mOutputFormatHelper.InsertEndIfTemplateGuard();
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CoroutineBodyStmt* stmt)
+{
+    InsertArg(stmt->getBody());
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const DependentCoawaitExpr* stmt)
+{
+    mOutputFormatHelper.Append(kwCoAwaitSpace);
+
+    InsertArg(stmt->getOperand());
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CoroutineSuspendExpr* stmt)
+{
+    //	co_await or co_yield
+    if(isa<CoyieldExpr>(stmt)) {
+        mOutputFormatHelper.Append(kwCoYieldSpace);
+    } else {
+        mOutputFormatHelper.Append(kwCoAwaitSpace);
+    }
+
+    // peal of __promise.yield_value
+    if(const auto* matTemp = dyn_cast_or_null<MaterializeTemporaryExpr>(stmt->getCommonExpr())) {
+        const auto* temporary = matTemp->getSubExpr();
+
+        if(const auto* memExpr = dyn_cast_or_null<CXXMemberCallExpr>(temporary)) {
+            ForEachArg(memExpr->arguments(), [&](const auto& arg) { InsertArg(arg); });
+
+            // Seems to be the path for a co_await expr
+        } else {
+            InsertArg(temporary);
+        }
+    } else if(const auto* unaryexpr = dyn_cast_or_null<UnaryOperator>(stmt->getOperand())) {
+        if(const auto* callExpr = dyn_cast_or_null<CallExpr>(unaryexpr->getSubExpr())) {
+            InsertArg(callExpr->getArg(0));
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CoreturnStmt* stmt)
+{
+    mOutputFormatHelper.Append(kwCoReturnSpace);
+    InsertArg(stmt->getOperand());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The standard library implementation, used to estimate the small buffer sizes of the library types.
+enum class StandardLibrary
+{
+    LibStdCxx,
+    LibCxx,
+    MicrosoftSTL,
+};
+//-----------------------------------------------------------------------------
+
+static StandardLibrary GetStandardLibrary()
+{
+    const auto& pp = GetGlobalCI().getPreprocessor();
+
+    if(pp.isMacroDefined("_LIBCPP_VERSION")) {
+        return StandardLibrary::LibCxx;
+
+    } else if(pp.isMacroDefined("_MSVC_STL_VERSION")) {
+        return StandardLibrary::MicrosoftSTL;
+    }
+
+    return StandardLibrary::LibStdCxx;
+}
+//-----------------------------------------------------------------------------
+
+static uint64_t GetPointerSize()
+{
+    return GetGlobalAST().getTypeSizeInChars(GetGlobalAST().VoidPtrTy).getQuantity();
+}
+//-----------------------------------------------------------------------------
+
+static std::optional<uint64_t> GetTypeSizeInBytes(QualType type)
+{
+    if(type.isNull() or type->isDependentType() or type->isIncompleteType() or type->isSizelessType()) {
+        return {};
+    }
+
+    return GetGlobalAST().getTypeSizeInChars(type).getQuantity();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The number of characters a \c std::string stores without allocating.
+static uint64_t GetStringSSOCapacity()
+{
+    switch(GetStandardLibrary()) {
+        case StandardLibrary::LibCxx: return (3 * GetPointerSize()) - 2;
+        case StandardLibrary::LibStdCxx:
+        case StandardLibrary::MicrosoftSTL: return 15;
+    }
+
+    return 15;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The size of a callable a \c std::function stores without allocating.
+static uint64_t GetFunctionSBOSize()
+{
+    switch(GetStandardLibrary()) {
+        case StandardLibrary::LibStdCxx: return 2 * GetPointerSize();
+        case StandardLibrary::LibCxx: return 3 * GetPointerSize();
+        case StandardLibrary::MicrosoftSTL: return 7 * GetPointerSize();
+    }
+
+    return 2 * GetPointerSize();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether copying an object of \p type does not throw, without declaring its implicit copy constructor.
+static bool IsCopyNothrow(QualType type)
+{
+    const auto* rd = GetGlobalAST().getBaseElementType(type)->getAsCXXRecordDecl();
+
+    if(not rd or not rd->hasDefinition() or rd->hasTrivialCopyConstructor()) {
+        return true;
+
+    } else if(const auto* copyCtor = FindCopyMember(rd, false)) {
+        return IsNothrow(copyCtor);
+    }
+
+    return ranges::all_of(rd->bases(), [](const auto& base) { return IsCopyNothrow(base.getType()); }) and
+           ranges::all_of(rd->fields(), [](const auto* field) { return IsCopyNothrow(field->getType()); });
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether moving \p record does not throw, without declaring its implicit move constructor.
+static bool IsMoveNothrow(const CXXRecordDecl* record)
+{
+    if(const auto* moveCtor = FindMoveMember(record, false)) {
+        return IsNothrow(moveCtor);
+
+    } else if(record->needsImplicitMoveConstructor()) {
+        return IsImplicitMoveNothrow(record, false);
+    }
+
+    return IsCopyNothrow(GetRecordDeclType(record));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief What keeps \c std::function from storing the callable \p record in its small buffer, besides the size.
+///
+/// libstdc++ stores only trivially copyable callables in place, libc++ only nothrow copy constructible ones and the
+/// Microsoft STL only nothrow move constructible ones. None of them over-aligns the buffer.
+static std::optional<std::string_view> GetFunctionSBOObstacle(const CXXRecordDecl* record)
+{
+    if(not record or record->isDependentType()) {
+        return {};
+    }
+
+    const auto& ctx  = GetGlobalAST();
+    const auto  type = GetRecordDeclType(record);
+
+    if(ctx.getTypeAlignInChars(type) > ctx.getTypeAlignInChars(ctx.VoidPtrTy)) {
+        return "suitably aligned"sv;
+    }
+
+    switch(GetStandardLibrary()) {
+        case StandardLibrary::LibStdCxx:
+            if(not type.isTriviallyCopyableType(ctx)) {
+                return "trivially copyable"sv;
+            }
+            break;
+        case StandardLibrary::LibCxx:
+            if(not IsCopyNothrow(type)) {
+                return "nothrow copy constructible"sv;
+            }
+            break;
+        case StandardLibrary::MicrosoftSTL:
+            if(not IsMoveNothrow(record)) {
+                return "nothrow move constructible"sv;
+            }
+            break;
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The approximate size of the control block \c std::make_shared places next to the object.
+static uint64_t GetSharedControlBlockSize()
+{
+    return ValueOr(StandardLibrary::LibCxx == GetStandardLibrary(), 3 * GetPointerSize(), 2 * GetPointerSize());
+}
+//-----------------------------------------------------------------------------
+
+static bool IsStdRecord(const CXXRecordDecl* record, std::string_view name)
+{
+    return record and record->isInStdNamespace() and record->getIdentifier() and (record->getName() == name);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Check whether \p stmt is a call to one of the standard library functions which allocate on the heap. If so,
+/// return the estimated allocation size.
+static std::optional<std::optional<uint64_t>> GetStdAllocatingCallSize(const CallExpr* stmt)
+{
+    const auto* fd = stmt->getDirectCallee();
+
+    if(not fd or not fd->isInStdNamespace() or not fd->getIdentifier()) {
+        return {};
+    }
+
+    const std::string_view name{fd->getName()};
+    const bool isShared{is{name}.any_of("make_shared"sv, "allocate_shared"sv, "make_shared_for_overwrite"sv)};
+    const bool isUnique{is{name}.any_of("make_unique"sv, "make_unique_for_overwrite"sv)};
+
+    if(not isShared and not isUnique) {
+        return {};
+    }
+
+    const auto* templateArgs = fd->getTemplateSpecializationArgs();
+    if(not templateArgs or templateArgs->size() == 0 or (TemplateArgument::Type != templateArgs->get(0).getKind())) {
+        return std::optional<uint64_t>{};
+    }
+
+    auto size = GetTypeSizeInBytes(templateArgs->get(0).getAsType());
+
+    if(size and isShared) {
+        *size += GetSharedControlBlockSize();
+    }
+
+    return size;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Check whether \p stmt constructs a \c std::function from a capturing lambda it cannot store in the small
+/// buffer or a \c std::string from a literal exceeding the SSO capacity. If so, return the estimated allocation size.
+static std::optional<uint64_t> GetStdAllocatingConstructionSize(const CXXConstructExpr* stmt)
+{
+    const auto* record = stmt->getConstructor()->getParent();
+
+    if((1 > stmt->getNumArgs()) or not record->isInStdNamespace()) {
+        return {};
+    }
+
+    const auto* arg = stmt->getArg(0)->IgnoreImplicit();
+
+    if(IsStdRecord(record, "function"sv)) {
+        if(const auto* lambda = dyn_cast_or_null<LambdaExpr>(arg); lambda and lambda->capture_size()) {
+            if(const auto size = GetTypeSizeInBytes(lambda->getType());
+               size and ((*size > GetFunctionSBOSize()) or GetFunctionSBOObstacle(lambda->getLambdaClass()))) {
+                return size;
+            }
+        }
+
+    } else if(IsStdRecord(record, "basic_string"sv)) {
+        if(const auto* str = dyn_cast_or_null<StringLiteral>(arg);
+           str and (1 == str->getCharByteWidth()) and (str->getLength() > GetStringSSOCapacity())) {
+            return str->getLength() + 1;
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+static bool IsStdMoveCall(const CallExpr* stmt)
+{
+    const auto* fd = stmt ? stmt->getDirectCallee() : nullptr;
+
+    return fd and fd->isInStdNamespace() and fd->getIdentifier() and (std::string_view{fd->getName()} == "move"sv) and
+           (1 == stmt->getNumArgs());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief A simple def-use pass over a function body to find missed and pessimizing moves.
+///
+/// The pass tracks for each local object and by-value parameter of class type the last use in source order. If this
+/// last use copies the object and is not inside a loop which does not also contain the declaration, a move is legal.
+/// Objects whose address is taken, which are bound to a reference or captured by reference are ignored.
+class MoveAuditor
+{
+    struct LocalUse
+    {
+        unsigned           declLoopDepth{};
+        const DeclRefExpr* lastUse{};
+        bool               lastUseInLoop{};
+        bool               escaped{};
+    };
+
+    llvm::DenseMap<const Expr*, std::string_view>&       mFindings;
+    llvm::MapVector<const VarDecl*, LocalUse>            mLocals{};
+    llvm::DenseMap<const DeclRefExpr*, std::string_view> mCopies{};  //!< Uses which copy the object.
+    const FunctionDecl&                                  mFunction;
+    unsigned                                             mLoopDepth{};
+
+    static bool IsMovableLocal(const VarDecl* vd)
+    {
+        if(not vd or not vd->hasLocalStorage()) {
+            return false;
+        }
+
+        const auto type = vd->getType();
+
+        return type->isRecordType() and not type.isConstQualified() and not type->isDependentType() and
+               not type.isTriviallyCopyableType(GetGlobalAST());
+    }
+
+    const VarDecl* GetLocal(const Expr* expr) const
+    {
+        if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(expr ? expr->IgnoreParenImpCasts() : nullptr)) {
+            if(const auto* vd = dyn_cast_or_null<VarDecl>(declRef->getDecl()); vd and mLocals.count(vd)) {
+                return vd;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void Escape(const Expr* expr)
+    {
+        if(const auto* vd = GetLocal(expr)) {
+            mLocals[vd].escaped = true;
+        }
+    }
+
+    void MarkCopy(const Expr* expr, std::string_view finding)
+    {
+        if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(expr->IgnoreParenImpCasts());
+           declRef and GetLocal(declRef)) {
+            mCopies[declRef] = finding;
+        }
+    }
+
+    void Register(const VarDecl* vd)
+    {
+        if(IsMovableLocal(vd)) {
+            mLocals[vd] = LocalUse{.declLoopDepth = mLoopDepth};
+        }
+    }
+
+    /// \brief Flag \p arg, if it is a \c std::move of a const object which a copy operation copies from.
+    ///
+    /// Only a class which is not trivially copyable is worth it. A const rvalue which just binds to a \c const& is not
+    /// copied at all.
+    void CheckConstMove(const Expr* arg)
+    {
+        const auto* moveCall = dyn_cast_or_null<CallExpr>(arg->IgnoreParenImpCasts());
+        RETURN_IF(not IsStdMoveCall(moveCall));
+
+        const auto type = moveCall->getArg(0)->getType();
+
+        if(type.isConstQualified() and type->isRecordType() and not type.isTriviallyCopyableType(GetGlobalAST())) {
+            mFindings[moveCall] = "std::move of a const object copies"sv;
+        }
+    }
+
+    void CheckPessimizingReturn(const ReturnStmt* stmt)
+    {
+        const auto* retVal = stmt->getRetValue();
+        RETURN_IF(not retVal);
+
+        const auto* construct = dyn_cast_or_null<CXXConstructExpr>(retVal->IgnoreImplicit());
+        const auto* moveCall  = dyn_cast_or_null<CallExpr>((construct and (1 == construct->getNumArgs()))
+                                                              ? construct->getArg(0)->IgnoreImplicit()
+                                                              : retVal->IgnoreImplicit());
+
+        RETURN_IF(not IsStdMoveCall(moveCall));
+
+        const auto* declRef = dyn_cast_or_null<DeclRefExpr>(moveCall->getArg(0)->IgnoreParenImpCasts());
+        const auto* vd      = declRef ? dyn_cast_or_null<VarDecl>(declRef->getDecl()) : nullptr;
+
+        if(vd and vd->isLocalVarDecl() and not vd->isStaticLocal() and not vd->getType()->isReferenceType() and
+           GetGlobalAST().hasSameUnqualifiedType(vd->getType(), mFunction.getReturnType())) {
+            mFindings[moveCall] = "pessimizing move prevents NRVO"sv;
+        }
+    }
+
+    void Visit(const Stmt* stmt)
+    {
+        RETURN_IF(not stmt);
+
+        if(const auto* lambda = dyn_cast_or_null<LambdaExpr>(stmt)) {
+            // The body of a lambda is audited on its own, only the captures are of interest here.
+            for(const auto& capture : lambda->captures()) {
+                if(capture.capturesVariable()) {
+                    if(const auto* vd = dyn_cast_or_null<VarDecl>(capture.getCapturedVar());
+                       vd and mLocals.count(vd)) {
+                        auto& local = mLocals[vd];
+
+                        if(LCK_ByRef == capture.getCaptureKind()) {
+                            local.escaped = true;
+                        } else {
+                            // A copy capture is a use, but not one we can change to a move here.
+                            local.lastUse = nullptr;
+                        }
+                    }
+                }
+            }
+
+            return;
+
+        } else if(const auto* declStmt = dyn_cast_or_null<DeclStmt>(stmt)) {
+            for(const auto* decl : declStmt->decls()) {
+                if(const auto* vd = dyn_cast_or_null<VarDecl>(decl)) {
+                    if(vd->getType()->isReferenceType()) {
+                        Escape(vd->getInit());
+                    }
+                }
+            }
+
+        } else if(const auto* unaryOp = dyn_cast_or_null<UnaryOperator>(stmt);
+                  unaryOp and (UO_AddrOf == unaryOp->getOpcode())) {
+            Escape(unaryOp->getSubExpr());
+
+        } else if(const auto* construct = dyn_cast_or_null<CXXConstructExpr>(stmt)) {
+            if(construct->getConstructor()->isCopyConstructor() and (1 <= construct->getNumArgs())) {
+                MarkCopy(construct->getArg(0), "copied on last use, std::move possible"sv);
+                CheckConstMove(construct->getArg(0));
+            }
+
+        } else if(const auto* opCall = dyn_cast_or_null<CXXOperatorCallExpr>(stmt)) {
+            if(const auto* method = dyn_cast_or_null<CXXMethodDecl>(opCall->getCalleeDecl());
+               method and method->isCopyAssignmentOperator() and (2 == opCall->getNumArgs())) {
+                MarkCopy(opCall->getArg(1), "copy assigned on last use, std::move possible"sv);
+                CheckConstMove(opCall->getArg(1));
+            }
+
+        } else if(const auto* memberCall = dyn_cast_or_null<CXXMemberCallExpr>(stmt)) {
+            const auto* method = memberCall->getMethodDecl();
+
+            if(method and method->getIdentifier() and
+               is{std::string_view{method->getName()}}.any_of("push_back"sv, "push_front"sv, "push"sv, "insert"sv)) {
+                for(unsigned i = 0; i < std::min(memberCall->getNumArgs(), method->getNumParams()); ++i) {
+                    if(const auto paramType = method->getParamDecl(i)->getType();
+                       paramType->isLValueReferenceType() and paramType->getPointeeType().isConstQualified()) {
+                        MarkCopy(memberCall->getArg(i), "copied into container on last use, std::move possible"sv);
+                    }
+                }
+            }
+
+
+        } else if(const auto* returnStmt = dyn_cast_or_null<ReturnStmt>(stmt)) {
+            CheckPessimizingReturn(returnStmt);
+
+        } else if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(stmt)) {
+            if(const auto* vd = GetLocal(declRef)) {
+                auto& local         = mLocals[vd];
+                local.lastUse       = declRef;
+                local.lastUseInLoop = mLoopDepth > local.declLoopDepth;
+            }
+        }
+
+        const bool isLoop{isa<ForStmt, WhileStmt, DoStmt, CXXForRangeStmt>(stmt)};
+
+        if(isLoop) {
+            ++mLoopDepth;
+        }
+
+        for(const auto* child : stmt->children()) {
+            Visit(child);
+        }
+
+        if(isLoop) {
+            --mLoopDepth;
+        }
+
+        // Declarations are registered after their initializer which can not refer to the object itself.
+        if(const auto* declStmt = dyn_cast_or_null<DeclStmt>(stmt)) {
+            for(const auto* decl : declStmt->decls()) {
+                Register(dyn_cast_or_null<VarDecl>(decl));
+            }
+        }
+    }
+
+public:
+    MoveAuditor(llvm::DenseMap<const Expr*, std::string_view>& findings, const FunctionDecl& function)
+    : mFindings{findings}
+    , mFunction{function}
+    {
+        for(const auto* param : function.parameters()) {
+            Register(param);
+        }
+
+        Visit(function.getBody());
+
+        for(const auto& [vd, local] : mLocals) {
+            if(local.escaped or local.lastUseInLoop or not local.lastUse) {
+                continue;
+            }
+
+            if(const auto iter = mCopies.find(local.lastUse); iter != mCopies.end()) {
+                mFindings[local.lastUse] = iter->second;
+            }
+        }
+    }
+};
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertMoveAuditComment(const Expr* stmt)
+{
+    RETURN_IF(not GetInsightsOptions().ShowMoveAudit);
+
+    const auto iter = mFunctionReport.moveAuditFindings.find(stmt);
+    RETURN_IF(iter == mFunctionReport.moveAuditFindings.end());
+
+    if(isa<DeclRefExpr>(stmt)) {
+        ++mFunctionReport.missedMoves;
+    } else {
+        ++mFunctionReport.pessimizingMoves;
+    }
+
+    mOutputFormatHelper.Append(kwCCommentStartSpace, iter->second, kwSpaceCCommentEndSpace);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Decide for each call to a coroutine in a function body whether the frame allocation can be elided (HALO).
+///
+/// The allocation can only be elided, if the lifetime of the coroutine is nested in the one of the caller. This is
+/// approximated by how the caller uses the returned object.
+class HALOClassifier
+{
+    struct Consumer
+    {
+        const Stmt*    stmt{};
+        const VarDecl* var{};  //!< The variable initialized by the result, if \c stmt is a \c DeclStmt.
+    };
+
+    llvm::DenseMap<const CallExpr*, std::string>& mFindings;
+    llvm::DenseSet<const VarDecl*>                mReturnedVars{};
+
+    /// \brief Nodes which pass the result of a call on to their parent.
+    static bool IsTransparent(const Stmt* stmt)
+    {
+        if(const auto* construct = dyn_cast_or_null<CXXConstructExpr>(stmt)) {
+            return (1 == construct->getNumArgs()) and construct->getConstructor()->isCopyOrMoveConstructor();
+        }
+
+        return isa_and_nonnull<ImplicitCastExpr,
+                               MaterializeTemporaryExpr,
+                               CXXBindTemporaryExpr,
+                               ExprWithCleanups,
+                               ParenExpr,
+                               ConstantExpr,
+                               CXXFunctionalCastExpr>(stmt);
+    }
+
+    void CollectReturnedVars(const Stmt* stmt)
+    {
+        RETURN_IF(not stmt or isa<LambdaExpr>(stmt));
+
+        if(const auto* returnStmt = dyn_cast_or_null<ReturnStmt>(stmt)) {
+            const Stmt* value = returnStmt->getRetValue();
+
+            while(IsTransparent(value)) {
+                value = *value->child_begin();
+            }
+
+            if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(value)) {
+                if(const auto* vd = dyn_cast_or_null<VarDecl>(declRef->getDecl())) {
+                    mReturnedVars.insert(vd);
+                }
+            }
+        }
+
+        for(const auto* child : stmt->children()) {
+            CollectReturnedVars(child);
+        }
     }
-}
-//-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CoroutineBodyStmt* stmt)
-{
-    InsertArg(stmt->getBody());
-}
-//-----------------------------------------------------------------------------
+    std::string Classify(const Consumer& consumer) const
+    {
+        if(const auto* vd = consumer.var) {
+            if(not vd->hasLocalStorage()) {
+                return std::string{"no HALO: stored in a static"sv};
 
-void CodeGenerator::InsertArg(const DependentCoawaitExpr* stmt)
-{
-    mOutputFormatHelper.Append(kwCoAwaitSpace);
+            } else if(mReturnedVars.contains(vd)) {
+                return StrCat("no HALO: "sv, GetName(*vd), " is returned to the caller"sv);
+            }
 
-    InsertArg(stmt->getOperand());
-}
-//-----------------------------------------------------------------------------
+            return StrCat("HALO candidate: lives in local "sv, GetName(*vd));
 
-void CodeGenerator::InsertArg(const CoroutineSuspendExpr* stmt)
-{
-    //	co_await or co_yield
-    if(isa<CoyieldExpr>(stmt)) {
-        mOutputFormatHelper.Append(kwCoYieldSpace);
-    } else {
-        mOutputFormatHelper.Append(kwCoAwaitSpace);
+        } else if(isa_and_nonnull<CoawaitExpr>(consumer.stmt)) {
+            return std::string{"HALO candidate: awaited immediately"sv};
+
+        } else if(isa_and_nonnull<ReturnStmt, CoreturnStmt>(consumer.stmt)) {
+            return std::string{"no HALO: returned to the caller"sv};
+
+        } else if(isa_and_nonnull<MemberExpr>(consumer.stmt) or not isa_and_nonnull<Expr>(consumer.stmt)) {
+            return std::string{"HALO candidate: destroyed at the end of the full-expression"sv};
+
+        } else if(const auto* binOp = dyn_cast_or_null<BinaryOperator>(consumer.stmt);
+                  binOp and binOp->isAssignmentOp()) {
+            return std::string{"no HALO: assigned to an existing object"sv};
+
+        } else if(const auto* opCall = dyn_cast_or_null<CXXOperatorCallExpr>(consumer.stmt);
+                  opCall and opCall->isAssignmentOp()) {
+            return std::string{"no HALO: assigned to an existing object"sv};
+
+        } else if(isa<CallExpr, CXXConstructExpr>(consumer.stmt)) {
+            return std::string{"no HALO: passed on to another function"sv};
+        }
+
+        return std::string{"no HALO: the result escapes"sv};
     }
 
-    // peal of __promise.yield_value
-    if(const auto* matTemp = dyn_cast_or_null<MaterializeTemporaryExpr>(stmt->getCommonExpr())) {
-        const auto* temporary = matTemp->getSubExpr();
+    void Visit(const Stmt* stmt, const Consumer& consumer)
+    {
+        // The body of a lambda is classified on its own.
+        RETURN_IF(not stmt or isa<LambdaExpr>(stmt));
 
-        if(const auto* memExpr = dyn_cast_or_null<CXXMemberCallExpr>(temporary)) {
-            ForEachArg(memExpr->arguments(), [&](const auto& arg) { InsertArg(arg); });
+        if(const auto* callExpr = dyn_cast_or_null<CallExpr>(stmt)) {
+            if(const auto* callee = callExpr->getDirectCallee(); IsCoroutine(callee)) {
+                if(const auto blocker = GetHALOBlocker(*callee)) {
+                    mFindings[callExpr] = StrCat("no HALO: "sv, *blocker);
+                } else {
+                    mFindings[callExpr] = Classify(consumer);
+                }
+            }
 
-            // Seems to be the path for a co_await expr
-        } else {
-            InsertArg(temporary);
+        } else if(const auto* declStmt = dyn_cast_or_null<DeclStmt>(stmt)) {
+            for(const auto* decl : declStmt->decls()) {
+                if(const auto* vd = dyn_cast_or_null<VarDecl>(decl)) {
+                    Visit(vd->getInit(), Consumer{.stmt = declStmt, .var = vd});
+                }
+            }
+
+            return;
         }
-    } else if(const auto* unaryexpr = dyn_cast_or_null<UnaryOperator>(stmt->getOperand())) {
-        if(const auto* callExpr = dyn_cast_or_null<CallExpr>(unaryexpr->getSubExpr())) {
-            InsertArg(callExpr->getArg(0));
+
+        const Consumer childConsumer{IsTransparent(stmt) ? consumer : Consumer{.stmt = stmt}};
+
+        for(const auto* child : stmt->children()) {
+            Visit(child, childConsumer);
         }
     }
-}
+
+public:
+    HALOClassifier(llvm::DenseMap<const CallExpr*, std::string>& findings, const Stmt* body)
+    : mFindings{findings}
+    {
+        CollectReturnedVars(body);
+        Visit(body, {});
+    }
+};
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CoreturnStmt* stmt)
+void CodeGenerator::InsertHALOComment(const CallExpr* stmt)
 {
-    mOutputFormatHelper.Append(kwCoReturnSpace);
-    InsertArg(stmt->getOperand());
+    RETURN_IF(not GetInsightsOptions().ShowHALO or InsideDecltype());
+
+    const auto iter = mFunctionReport.haloFindings.find(stmt);
+    RETURN_IF(iter == mFunctionReport.haloFindings.end());
+
+    mOutputFormatHelper.Append(" "sv, kwCCommentStartSpace, iter->second, kwSpaceCCommentEnd);
 }
 //-----------------------------------------------------------------------------
 
@@ -1572,6 +3191,18 @@ void CodeGenerator::InsertMethodBody(const FunctionDecl* stmt, const size_t posB
     };
 
     if(stmt->doesThisDeclarationHaveABody()) {
+        BackupAndRestore _{mFunctionReport, FunctionReport{.function = stmt}};
+
+        if(GetInsightsOptions().ShowMoveAudit) {
+            MoveAuditor moveAuditor{mFunctionReport.moveAuditFindings, *stmt};
+        }
+
+        if(GetInsightsOptions().ShowHALO) {
+            HALOClassifier haloClassifier{mFunctionReport.haloFindings, stmt->getBody()};
+        }
+
+        InsertNRVOComment(*stmt);
+
         mOutputFormatHelper.AppendNewLine();
 
         // If this function has a CoroutineBodyStmt as direct descend and coroutine transformation is enabled use
@@ -1614,6 +3245,8 @@ void CodeGenerator::InsertMethodBody(const FunctionDecl* stmt, const size_t posB
         }
 
         mOutputFormatHelper.AppendNewLine();
+
+        InsertFunctionReport();
     } else {
         mOutputFormatHelper.AppendSemiNewLine();
     }
@@ -1807,7 +3440,7 @@ void CodeGenerator::InsertArg(const ClassTemplateDecl* stmt)
                  });
 
     for(const auto* spec : specializations) {
-        InsertArg(spec);
+        InsertTemplateSpecialization(stmt, spec, [&] { InsertArg(spec); });
     }
 }
 //-----------------------------------------------------------------------------
@@ -1899,6 +3532,8 @@ void CodeGenerator::InsertArg(const CXXDefaultInitExpr* stmt)
 
 void CodeGenerator::InsertArg(const CXXDeleteExpr* stmt)
 {
+    InsertDeallocationComment();
+
     mOutputFormatHelper.Append(kwDelete);
 
     if(stmt->isArrayForm()) {
@@ -1938,98 +3573,393 @@ void CodeGenerator::InsertConstructorExpr(const auto* stmt)
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CXXConstructExpr* stmt)
-{
-    InsertConstructorExpr(stmt);
-}
-//-----------------------------------------------------------------------------
+void CodeGenerator::InsertArg(const CXXConstructExpr* stmt)
+{
+    if(GetInsightsOptions().ShowAllocations) {
+        if(const auto bytes = GetStdAllocatingConstructionSize(stmt)) {
+            InsertAllocationComment(bytes);
+        }
+    }
+
+    InsertConstructorExpr(stmt);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXUnresolvedConstructExpr* stmt)
+{
+    BackupAndRestore _{mNoEmptyInitList, NoEmptyInitList::Yes};
+
+    InsertConstructorExpr(stmt);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const UnresolvedMemberExpr* stmt)
+{
+    // InsertArg(stmt->getBase());
+    // const std::string op{};  // stmt->isArrow() ? "->" : "."};
+
+    // mOutputFormatHelper.Append(op, stmt->getMemberNameInfo().getAsString());
+    mOutputFormatHelper.Append(stmt->getMemberNameInfo().getAsString());
+
+    if(stmt->getNumTemplateArgs()) {
+        InsertTemplateArgs(*stmt);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const PackExpansionExpr* stmt)
+{
+    InsertArg(stmt->getPattern());
+    mOutputFormatHelper.Append(kwElipsisSpace);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXFoldExpr* stmt)
+{
+    auto operatorStr = BinaryOperator::getOpcodeStr(stmt->getOperator());
+
+    WrapInParens([&] {
+        // We have a binary NNN fold. If init is nullptr, then it is a unary NNN fold.
+        const auto* init = stmt->getInit();
+
+        if(stmt->isLeftFold()) {
+            if(init) {
+                InsertArg(init);
+                mOutputFormatHelper.Append(" "sv, operatorStr, " "sv);
+            }
+
+            mOutputFormatHelper.Append(kwElipsisSpace, operatorStr, " "sv);
+        }
+
+        InsertArg(stmt->getPattern());
+
+        if(stmt->isRightFold()) {
+            mOutputFormatHelper.Append(" "sv, operatorStr, " "sv, kwElipsis);
+
+            if(init) {
+                mOutputFormatHelper.Append(" "sv, operatorStr, " "sv);
+                InsertArg(init);
+            }
+        }
+    });
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXInheritedCtorInitExpr* stmt)
+{
+    const auto& constructorDecl = *stmt->getConstructor();
+
+    mOutputFormatHelper.Append(GetName(GetDesugarType(stmt->getType()), Unqualified::Yes));
+    WrapInParens([&]() {
+        mOutputFormatHelper.AppendParameterList(constructorDecl.parameters(),
+                                                OutputFormatHelper::NameOnly::Yes,
+                                                OutputFormatHelper::GenMissingParamName::Yes);
+    });
+}
+//-----------------------------------------------------------------------------
+
+bool CodeGenerator::InsideDecltype() const
+{
+    return (not mLambdaStack.empty()) and (LambdaCallerType::Decltype == mLambdaStack.back().callerType());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Get the index of \p method in the vtable of its class, if the Itanium ABI is used.
+static std::optional<uint64_t> GetVTableSlot(const CXXMethodDecl* method)
+{
+    const auto* record = method->getParent();
+
+    if(record->isDependentContext() or not record->hasDefinition() or not record->isDynamicClass()) {
+        return {};
+    }
+
+    if(auto* itctx = dyn_cast_or_null<ItaniumVTableContext>(
+           const_cast<ASTContext&>(GetGlobalAST()).getVTableContext())) {
+        if(const auto* dtor = dyn_cast_or_null<CXXDestructorDecl>(method)) {
+            return itctx->getMethodVTableIndex(GlobalDecl{dtor, Dtor_Complete});
+        }
+
+        return itctx->getMethodVTableIndex(GlobalDecl{method});
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Check whether the virtual call \p stmt can be resolved statically and return the reason for it.
+static std::optional<std::string_view> GetDevirtualizationReason(const CXXMemberCallExpr& stmt,
+                                                                 const MemberExpr&        callee,
+                                                                 const FunctionDecl*      currentFunction)
+{
+    if(stmt.getMethodDecl()->hasAttr<FinalAttr>()) {
+        return "final method"sv;
+
+    } else if(const auto* record = stmt.getRecordDecl(); record and record->hasAttr<FinalAttr>()) {
+        return "final class"sv;
+    }
+
+    const auto* object = stmt.getImplicitObjectArgument()->IgnoreParenImpCasts();
+
+    // During construction and destruction the dynamic type is the class of the constructor or destructor.
+    if(isa<CXXThisExpr>(object)) {
+        if(isa_and_nonnull<CXXConstructorDecl>(currentFunction)) {
+            return "call during construction"sv;
+
+        } else if(isa_and_nonnull<CXXDestructorDecl>(currentFunction)) {
+            return "call during destruction"sv;
+        }
+
+        return {};
+    }
+
+    if(callee.isArrow()) {
+        return {};
+    }
+
+    // An object, which is neither a pointer nor a reference, has a known dynamic type.
+    if(isa<MaterializeTemporaryExpr>(object)) {
+        return "known dynamic type"sv;
+    }
+
+    const auto* valueDecl = [&]() -> const ValueDecl* {
+        if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(object)) {
+            return declRef->getDecl();
+
+        } else if(const auto* member = dyn_cast_or_null<MemberExpr>(object)) {
+            return member->getMemberDecl();
+        }
+
+        return nullptr;
+    }();
+
+    if(valueDecl and not valueDecl->getType()->isReferenceType()) {
+        return "known dynamic type"sv;
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertDispatchComment(const CXXMemberCallExpr* stmt)
+{
+    RETURN_IF(not GetInsightsOptions().ShowDispatch or InsideDecltype());
+
+    const auto* callee = dyn_cast_or_null<MemberExpr>(stmt->getCallee()->IgnoreParens());
+    const auto* method = stmt->getMethodDecl();
+
+    // A call through a pointer to member function
+    RETURN_IF(not callee or not method);
+
+    auto insertComment = [&](std::string_view kind, std::string_view reason) {
+        mOutputFormatHelper.Append(" "sv, kwCCommentStartSpace, kind, reason);
+
+        if(const auto slot = GetVTableSlot(method)) {
+            mOutputFormatHelper.Append(", vtable slot "sv, *slot);
+        }
+
+        mOutputFormatHelper.Append(kwSpaceCCommentEnd);
+    };
+
+    if(not method->isVirtual()) {
+        mOutputFormatHelper.Append(" "sv, kwCCommentStartSpace, "direct call"sv, kwSpaceCCommentEnd);
+
+    } else if(callee->hasQualifier()) {
+        insertComment("direct call: qualified name"sv, {});
+
+    } else if(const auto reason = GetDevirtualizationReason(*stmt, *callee, mFunctionReport.function)) {
+        ++mFunctionReport.devirtualizableCalls;
+
+        insertComment("devirtualizable: "sv, *reason);
+
+    } else {
+        ++mFunctionReport.indirectCalls;
+
+        insertComment("virtual call"sv, {});
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXMemberCallExpr* stmt)
+{
+    CONDITIONAL_LAMBDA_SCOPE_HELPER(MemberCallExpr, not InsideDecltype())
+
+    InsertArg(stmt->getCallee());
+
+    WrapInParens([&]() { ForEachArg(stmt->arguments(), [&](const auto& arg) { InsertArg(arg); }); });
+
+    InsertDispatchComment(stmt);
+    InsertHALOComment(stmt);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Collect the implicit operations a loop executes with each iteration.
+///
+/// Nested loops are not entered, they show their own costs. The same is true for the body of a lambda. The initializer
+/// of a local static runs only once, what remains per iteration is the check of its guard.
+class LoopCostCollector
+{
+    const FunctionDecl* mFunction{};
+
+public:
+    unsigned       constructions{};
+    unsigned       destructions{};
+    unsigned       temporaries{};
+    unsigned       virtualCalls{};
+    unsigned       staticGuards{};
+    unsigned       nestedLoops{};
+    const VarDecl* copiedLoopVar{};
+
+    LoopCostCollector(const Stmt& loop, const FunctionDecl* currentFunction)
+    : mFunction{currentFunction}
+    {
+        if(const auto* rangeForStmt = dyn_cast_or_null<CXXForRangeStmt>(&loop)) {
+            if(const auto* loopVar = rangeForStmt->getLoopVariable();
+               not loopVar->getType()->isReferenceType() and loopVar->getType()->isRecordType()) {
+                copiedLoopVar = loopVar;
+            }
+
+            Visit(rangeForStmt->getLoopVarStmt());
+            Visit(rangeForStmt->getCond());
+            Visit(rangeForStmt->getInc());
+            Visit(rangeForStmt->getBody());
+
+        } else if(const auto* forStmt = dyn_cast_or_null<ForStmt>(&loop)) {
+            Visit(forStmt->getConditionVariableDeclStmt());
+            Visit(forStmt->getCond());
+            Visit(forStmt->getInc());
+            Visit(forStmt->getBody());
+
+        } else if(const auto* whileStmt = dyn_cast_or_null<WhileStmt>(&loop)) {
+            Visit(whileStmt->getConditionVariableDeclStmt());
+            Visit(whileStmt->getCond());
+            Visit(whileStmt->getBody());
+
+        } else if(const auto* doStmt = dyn_cast_or_null<DoStmt>(&loop)) {
+            Visit(doStmt->getBody());
+            Visit(doStmt->getCond());
+        }
+    }
+
+private:
+    void Visit(const Stmt* stmt)
+    {
+        RETURN_IF(not stmt);
+
+        if(isa<ForStmt, WhileStmt, DoStmt, CXXForRangeStmt>(stmt)) {
+            ++nestedLoops;
+            return;
+
+        } else if(const auto* lambda = dyn_cast_or_null<LambdaExpr>(stmt)) {
+            for(const auto* init : lambda->capture_inits()) {
+                Visit(init);
+            }
+
+            return;
+
+        } else if(const auto* declStmt = dyn_cast_or_null<DeclStmt>(stmt)) {
+            for(const auto* decl : declStmt->decls()) {
+                const auto* vd = dyn_cast_or_null<VarDecl>(decl);
+
+                if(not vd) {
+                    continue;
+
+                } else if(vd->isStaticLocal()) {
+                    if(vd->hasInit() and not vd->hasConstantInitialization()) {
+                        ++staticGuards;
+                    }
+
+                    continue;
+                }
+
+                if(QualType::DK_cxx_destructor == vd->getType().isDestructedType()) {
+                    ++destructions;
+                }
+
+                Visit(vd->getInit());
+            }
 
-void CodeGenerator::InsertArg(const CXXUnresolvedConstructExpr* stmt)
-{
-    BackupAndRestore _{mNoEmptyInitList, NoEmptyInitList::Yes};
+            return;
 
-    InsertConstructorExpr(stmt);
-}
-//-----------------------------------------------------------------------------
+        } else if(const auto* construct = dyn_cast_or_null<CXXConstructExpr>(stmt)) {
+            if(not construct->getConstructor()->isTrivial() and not construct->isElidable()) {
+                ++constructions;
+            }
 
-void CodeGenerator::InsertArg(const UnresolvedMemberExpr* stmt)
-{
-    // InsertArg(stmt->getBase());
-    // const std::string op{};  // stmt->isArrow() ? "->" : "."};
+        } else if(isa<CXXBindTemporaryExpr>(stmt)) {
+            ++temporaries;
+            ++destructions;
 
-    // mOutputFormatHelper.Append(op, stmt->getMemberNameInfo().getAsString());
-    mOutputFormatHelper.Append(stmt->getMemberNameInfo().getAsString());
+        } else if(const auto* materialized = dyn_cast_or_null<MaterializeTemporaryExpr>(stmt)) {
+            // A bound temporary is counted on its own
+            if(not isa<CXXBindTemporaryExpr>(materialized->getSubExpr())) {
+                ++temporaries;
+            }
 
-    if(stmt->getNumTemplateArgs()) {
-        InsertTemplateArgs(*stmt);
-    }
-}
-//-----------------------------------------------------------------------------
+        } else if(const auto* memberCall = dyn_cast_or_null<CXXMemberCallExpr>(stmt)) {
+            const auto* callee = dyn_cast_or_null<MemberExpr>(memberCall->getCallee()->IgnoreParens());
+            const auto* method = memberCall->getMethodDecl();
 
-void CodeGenerator::InsertArg(const PackExpansionExpr* stmt)
-{
-    InsertArg(stmt->getPattern());
-    mOutputFormatHelper.Append(kwElipsisSpace);
-}
+            if(callee and method and method->isVirtual() and not callee->hasQualifier() and
+               not GetDevirtualizationReason(*memberCall, *callee, mFunction)) {
+                ++virtualCalls;
+            }
+        }
+
+        for(const auto* child : stmt->children()) {
+            Visit(child);
+        }
+    }
+};
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CXXFoldExpr* stmt)
+void CodeGenerator::InsertLoopCostComment(const Stmt* stmt)
 {
-    auto operatorStr = BinaryOperator::getOpcodeStr(stmt->getOperator());
+    RETURN_IF(not GetInsightsOptions().ShowLoopCosts or InsideDecltype() or (mLoweredLoop == stmt));
 
-    WrapInParens([&] {
-        // We have a binary NNN fold. If init is nullptr, then it is a unary NNN fold.
-        const auto* init = stmt->getInit();
+    const LoopCostCollector costs{*stmt, mFunctionReport.function};
 
-        if(stmt->isLeftFold()) {
-            if(init) {
-                InsertArg(init);
-                mOutputFormatHelper.Append(" "sv, operatorStr, " "sv);
-            }
+    SmallVector<std::string, 7> parts{};
 
-            mOutputFormatHelper.Append(kwElipsisSpace, operatorStr, " "sv);
+    auto addCount = [&](unsigned count, std::string_view singular, std::string_view plural) {
+        if(count) {
+            parts.push_back(StrCat(count, " "sv, ValueOr(1 < count, plural, singular)));
         }
+    };
 
-        InsertArg(stmt->getPattern());
+    addCount(costs.constructions, "constructor call"sv, "constructor calls"sv);
+    addCount(costs.destructions, "destructor call"sv, "destructor calls"sv);
 
-        if(stmt->isRightFold()) {
-            mOutputFormatHelper.Append(" "sv, operatorStr, " "sv, kwElipsis);
+    if(const auto* loopVar = costs.copiedLoopVar) {
+        std::string copy{StrCat("copy of loop variable "sv, GetName(*loopVar), ": "sv, GetName(loopVar->getType()))};
 
-            if(init) {
-                mOutputFormatHelper.Append(" "sv, operatorStr, " "sv);
-                InsertArg(init);
-            }
+        if(const auto size = GetTypeSizeInBytes(loopVar->getType())) {
+            copy.append(StrCat(" (sizeof: "sv, *size, ")"sv));
         }
-    });
-}
-//-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CXXInheritedCtorInitExpr* stmt)
-{
-    const auto& constructorDecl = *stmt->getConstructor();
+        parts.push_back(std::move(copy));
+    }
 
-    mOutputFormatHelper.Append(GetName(GetDesugarType(stmt->getType()), Unqualified::Yes));
-    WrapInParens([&]() {
-        mOutputFormatHelper.AppendParameterList(constructorDecl.parameters(),
-                                                OutputFormatHelper::NameOnly::Yes,
-                                                OutputFormatHelper::GenMissingParamName::Yes);
-    });
-}
-//-----------------------------------------------------------------------------
+    addCount(costs.temporaries, "temporary"sv, "temporaries"sv);
+    addCount(costs.virtualCalls, "virtual call"sv, "virtual calls"sv);
+    addCount(costs.staticGuards, "static guard check"sv, "static guard checks"sv);
+    addCount(costs.nestedLoops, "nested loop"sv, "nested loops"sv);
 
-bool CodeGenerator::InsideDecltype() const
-{
-    return (not mLambdaStack.empty()) and (LambdaCallerType::Decltype == mLambdaStack.back().callerType());
-}
-//-----------------------------------------------------------------------------
+    if(parts.empty()) {
+        mOutputFormatHelper.AppendCommentNewLine("per iteration: no hidden operations"sv);
+        return;
+    }
 
-void CodeGenerator::InsertArg(const CXXMemberCallExpr* stmt)
-{
-    CONDITIONAL_LAMBDA_SCOPE_HELPER(MemberCallExpr, not InsideDecltype())
+    std::string summary{"per iteration: "};
 
-    InsertArg(stmt->getCallee());
+    for(OnceFalse needsComma{}; const auto& part : parts) {
+        if(needsComma) {
+            summary.append(", "sv);
+        }
 
-    WrapInParens([&]() { ForEachArg(stmt->arguments(), [&](const auto& arg) { InsertArg(arg); }); });
+        summary.append(part);
+    }
+
+    mOutputFormatHelper.AppendCommentNewLine(summary);
 }
 //-----------------------------------------------------------------------------
 
@@ -2127,6 +4057,14 @@ void CodeGenerator::InsertArg(const CallExpr* stmt)
 
     UpdateCurrentPos(mCurrentCallExprPos);
 
+    if(GetInsightsOptions().ShowAllocations and not insideDecltype) {
+        if(const auto bytes = GetStdAllocatingCallSize(stmt)) {
+            InsertAllocationComment(*bytes);
+        }
+    }
+
+    InsertMoveAuditComment(stmt);
+
     InsertArg(stmt->getCallee());
 
     if(const auto* declRefExpr = dyn_cast_or_null<DeclRefExpr>(stmt->getCallee()->IgnoreImpCasts())) {
@@ -2170,6 +4108,8 @@ void CodeGenerator::InsertArg(const CallExpr* stmt)
         });
     });
 
+    InsertHALOComment(stmt);
+
     if(insideDecltype) {
         mLambdaStack.back().setInsertName(false);
     }
@@ -2187,12 +4127,82 @@ void CodeGenerator::InsertArg(const CXXNamedCastExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Estimate the runtime cost of an implicit conversion. Conversions without cost return an empty optional,
+/// otherwise the value is higher the more expensive the conversion is.
+static std::optional<unsigned> GetImplicitCastCost(const ImplicitCastExpr& stmt, bool inLoop)
+{
+    // Conversions of literals happen at compile-time
+    if(isa<IntegerLiteral, FloatingLiteral, CXXBoolLiteralExpr, CharacterLiteral>(stmt.getSubExpr()->IgnoreParens()) or
+       stmt.isPartOfExplicitCast()) {
+        return {};
+    }
+
+    const auto destType = stmt.getType();
+    const auto srcType  = stmt.getSubExpr()->getType();
+
+    auto isNarrowing = [&] {
+        const auto srcSize  = GetTypeSizeInBytes(srcType);
+        const auto destSize = GetTypeSizeInBytes(destType);
+
+        return srcSize and destSize and (*destSize < *srcSize);
+    };
+
+    switch(stmt.getCastKind()) {
+        // These construct objects or call a conversion function
+        case CastKind::CK_ConstructorConversion: [[fallthrough]];
+        case CastKind::CK_UserDefinedConversion: return 3;
+
+        case CastKind::CK_DerivedToBase: [[fallthrough]];
+        case CastKind::CK_UncheckedDerivedToBase:
+            // Only a conversion through a virtual base requires a lookup in the vtable
+            if(ranges::any_of(stmt.path(), [](const CXXBaseSpecifier* base) { return base->isVirtual(); })) {
+                return 3;
+            }
+
+            return {};
+
+        case CastKind::CK_IntegralToFloating: [[fallthrough]];
+        case CastKind::CK_FloatingToIntegral: return 2;
+
+        case CastKind::CK_FloatingCast:
+            if(inLoop or isNarrowing()) {
+                return 1;
+            }
+
+            return {};
+
+        case CastKind::CK_IntegralCast:
+            if(isNarrowing()) {
+                return 1;
+            }
+
+            return {};
+
+        default: return {};
+    }
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const ImplicitCastExpr* stmt)
 {
     const Expr* subExpr  = stmt->getSubExpr();
     const auto  castKind = stmt->getCastKind();
     const bool  hideImplicitCasts{not GetInsightsOptions().ShowAllImplicitCasts};
 
+    if(GetInsightsOptions().ShowCostlyImplicitCasts and not InsideDecltype()) {
+        if(const auto cost = GetImplicitCastCost(*stmt, 0 < mLoopDepth)) {
+            PushCostlyImplicitCast(castKind, *cost);
+
+            mOutputFormatHelper.Append(kwCCommentStartSpace,
+                                       "costly conversion: "sv,
+                                       stmt->getCastKindName(),
+                                       " ("sv,
+                                       GetCostName(*cost),
+                                       ")"sv,
+                                       kwSpaceCCommentEndSpace);
+        }
+    }
+
     auto isMatchingCast = [](const CastKind kind, const bool hideImplicitCasts, const bool showXValueCasts) {
         switch(kind) {
             case CastKind::CK_Dependent: [[fallthrough]];
@@ -2274,6 +4284,8 @@ void CodeGenerator::InsertArg(const ImplicitCastExpr* stmt)
 
 void CodeGenerator::InsertArg(const DeclRefExpr* stmt)
 {
+    InsertMoveAuditComment(stmt);
+
     if(const auto* vd = dyn_cast_or_null<VarDecl>(stmt->getDecl());
        GetInsightsOptions().UseShow2C and IsReferenceType(vd)) {
         const auto* init = vd->getInit();
@@ -2494,6 +4506,8 @@ void CodeGenerator::InsertArg(const ForStmt* stmt)
     // http://clang-developers.42468.n3.nabble.com/Adding-nodes-to-Clang-s-AST-td4054800.html
     // https://stackoverflow.com/questions/30451485/how-to-clone-or-create-an-ast-stmt-node-of-clang/38899615
 
+    InsertLoopCostComment(stmt);
+
     if(GetInsightsOptions().UseAltForSyntax) {
         auto*          rwStmt = const_cast<ForStmt*>(stmt);
         const auto&    ctx    = GetGlobalAST();
@@ -2529,10 +4543,15 @@ void CodeGenerator::InsertArg(const ForStmt* stmt)
 
         auto* outerScopeBody = mkCompoundStmt(outerScopeStmts, stmt->getBeginLoc(), stmt->getEndLoc());
 
+        BackupAndRestore _{mLoweredLoop, static_cast<const Stmt*>(whileStmt)};
+
         InsertArg(outerScopeBody);
         mOutputFormatHelper.AppendNewLine();
 
     } else {
+        // The init-statement is generated by its own code generator and with that not counted as part of the loop.
+        BackupAndRestore _{mLoopDepth, mLoopDepth + 1};
+
         {
             // We need to handle the case that a lambda is used in the init-statement of the for-loop.
             LAMBDA_SCOPE_HELPER(VarDecl);
@@ -2590,12 +4609,111 @@ void CodeGenerator::InsertArg(const CStyleCastExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+void CodeGenerator::InsertAllocationComment(std::optional<uint64_t> bytes)
+{
+    RETURN_IF(not GetInsightsOptions().ShowAllocations);
+
+    ++mFunctionReport.allocations;
+
+    if(bytes) {
+        mFunctionReport.allocatedBytes += *bytes;
+
+        mOutputFormatHelper.Append(
+            kwCCommentStartSpace, "heap allocation: "sv, *bytes, " bytes"sv, kwSpaceCCommentEndSpace);
+
+    } else {
+        mOutputFormatHelper.Append(kwCCommentStartSpace, "heap allocation: unknown size"sv, kwSpaceCCommentEndSpace);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertAllocationComment(const CXXNewExpr* stmt)
+{
+    RETURN_IF(not GetInsightsOptions().ShowAllocations);
+
+    // A placement new does not allocate anything.
+    if(const auto* opNew = stmt->getOperatorNew(); opNew and opNew->isReservedGlobalPlacementOperator()) {
+        return;
+    }
+
+    auto bytes = GetTypeSizeInBytes(stmt->getAllocatedType());
+
+    if(bytes and stmt->isArray()) {
+        bytes = [&]() -> std::optional<uint64_t> {
+            if(const auto arraySize = stmt->getArraySize(); arraySize and *arraySize) {
+                if(not(*arraySize)->isValueDependent()) {
+                    if(const auto count = (*arraySize)->getIntegerConstantExpr(GetGlobalAST())) {
+                        return *bytes * count->getZExtValue();
+                    }
+                }
+            }
+
+            return {};
+        }();
+    }
+
+    InsertAllocationComment(bytes);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertDeallocationComment()
+{
+    RETURN_IF(not GetInsightsOptions().ShowAllocations);
+
+    ++mFunctionReport.deallocations;
+
+    mOutputFormatHelper.Append(kwCCommentStartSpace, "heap deallocation"sv, kwSpaceCCommentEndSpace);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertFunctionReport()
+{
+    RETURN_IF(mFunctionReport.empty());
+
+    if(GetInsightsOptions().ShowAllocations) {
+        mOutputFormatHelper.AppendCommentNewLine(GetName(*mFunctionReport.function),
+                                                 ": allocations: "sv,
+                                                 mFunctionReport.allocations,
+                                                 ", estimated bytes: "sv,
+                                                 mFunctionReport.allocatedBytes,
+                                                 ", deallocations: "sv,
+                                                 mFunctionReport.deallocations);
+    }
+
+    if(GetInsightsOptions().ShowDispatch) {
+        mOutputFormatHelper.AppendCommentNewLine(GetName(*mFunctionReport.function),
+                                                 ": indirect calls: "sv,
+                                                 mFunctionReport.indirectCalls,
+                                                 ", devirtualizable calls: "sv,
+                                                 mFunctionReport.devirtualizableCalls);
+    }
+
+    if(GetInsightsOptions().ShowMoveAudit) {
+        mOutputFormatHelper.AppendCommentNewLine(GetName(*mFunctionReport.function),
+                                                 ": missed moves: "sv,
+                                                 mFunctionReport.missedMoves,
+                                                 ", pessimizing moves: "sv,
+                                                 mFunctionReport.pessimizingMoves);
+    }
+
+    if(GetInsightsOptions().ShowTemporaries) {
+        mOutputFormatHelper.AppendCommentNewLine(GetName(*mFunctionReport.function),
+                                                 ": temporaries: "sv,
+                                                 mFunctionReport.temporaries,
+                                                 ", in loops: "sv,
+                                                 mFunctionReport.temporariesInLoops);
+    }
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const CXXNewExpr* stmt)
 {
     const auto  noEmptyInitList = mNoEmptyInitList;
     FinalAction _{[&] { mNoEmptyInitList = noEmptyInitList; }};
     mNoEmptyInitList = GetInsightsOptions().UseShow2C ? NoEmptyInitList::Yes : NoEmptyInitList::No;
 
+    InsertAllocationComment(stmt);
+
     mOutputFormatHelper.Append("new "sv);
 
     if(stmt->getNumPlacementArgs()) {
@@ -2640,11 +4758,56 @@ void CodeGenerator::InsertArg(const CXXNewExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+void CodeGenerator::InsertTemporaryComment(const Expr* stmt)
+{
+    RETURN_IF(not GetInsightsOptions().ShowTemporaries or InsideDecltype());
+
+    const auto type = stmt->getType();
+    const bool inLoop{0 < mLoopDepth};
+
+    ++mFunctionReport.temporaries;
+
+    if(inLoop) {
+        ++mFunctionReport.temporariesInLoops;
+    }
+
+    const auto lifetime = [&]() -> std::string {
+        if(const auto* materialized = dyn_cast_or_null<MaterializeTemporaryExpr>(stmt)) {
+            if(const auto* extendingDecl = materialized->getExtendingDecl()) {
+                return StrCat("lifetime extended by "sv, GetName(*extendingDecl));
+            }
+        }
+
+        return StrCat(ValueOr(type.isDestructedType() != QualType::DK_none, "destroyed"sv, "lifetime ends"sv),
+                      " at end of full-expression"sv);
+    }();
+
+    mOutputFormatHelper.Append(kwCCommentStartSpace, GetTemporaryName(*stmt), ": "sv, GetName(type));
+
+    if(const auto size = GetTypeSizeInBytes(type)) {
+        mOutputFormatHelper.Append(", sizeof: "sv, *size);
+    }
+
+    mOutputFormatHelper.Append(
+        ", "sv, lifetime, ValueOrDefault(inLoop, ", created in loop"sv), kwSpaceCCommentEndSpace);
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const MaterializeTemporaryExpr* stmt)
 {
+    InsertTemporaryComment(stmt);
+
     // At least in case of a ternary operator wrapped inside a MaterializeTemporaryExpr parens are necessary
     const auto* temporary = stmt->getSubExpr();
-    WrapInParensIfNeeded(isa_and_nonnull<ConditionalOperator>(temporary), [&] { InsertArg(temporary); });
+    const bool  needsParens{isa_and_nonnull<ConditionalOperator>(temporary)};
+
+    // The bound temporary is the one materialized here. Skip it to not report the same temporary twice.
+    if(const auto* bindTemporary = dyn_cast_or_null<CXXBindTemporaryExpr>(temporary);
+       bindTemporary and GetInsightsOptions().ShowTemporaries) {
+        temporary = bindTemporary->getSubExpr();
+    }
+
+    WrapInParensIfNeeded(needsParens, [&] { InsertArg(temporary); });
 }
 //-----------------------------------------------------------------------------
 
@@ -2795,6 +4958,8 @@ void CodeGenerator::InsertArg(const CXXThisExpr* stmt)
 
 void CodeGenerator::InsertArg(const CXXBindTemporaryExpr* stmt)
 {
+    InsertTemporaryComment(stmt);
+
     InsertArg(stmt->getSubExpr());
 }
 //-----------------------------------------------------------------------------
@@ -3258,6 +5423,38 @@ static auto& GetRecordLayout(const RecordDecl* recordDecl)
 }
 //-----------------------------------------------------------------------------
 
+void CodeGenerator::InsertClosureSizeComment(const CXXRecordDecl* stmt)
+{
+    const uint64_t closureSize = GetRecordLayout(stmt).getSize().getQuantity();
+    const uint64_t bufferSize{ValueOr(0 != GetInsightsOptions().LambdaSBOSize,
+                                      static_cast<uint64_t>(GetInsightsOptions().LambdaSBOSize),
+                                      GetFunctionSBOSize())};
+
+    if(closureSize > bufferSize) {
+        mOutputFormatHelper.AppendCommentNewLine("closure exceeds the small buffer of "sv,
+                                                 bufferSize,
+                                                 " bytes, storing it type-erased allocates"sv);
+
+    } else if(const auto obstacle = GetFunctionSBOObstacle(stmt)) {
+        mOutputFormatHelper.AppendCommentNewLine("closure fits the small buffer of "sv,
+                                                 bufferSize,
+                                                 " bytes, but is not "sv,
+                                                 obstacle.value(),
+                                                 ", storing it type-erased allocates"sv);
+    }
+}
+//-----------------------------------------------------------------------------
+
+bool CodeGenerator::ShowPadding(const RecordDecl* record) const
+{
+    const auto* cxxRecordDecl = dyn_cast_or_null<CXXRecordDecl>(record);
+    const bool  isLambda{cxxRecordDecl and cxxRecordDecl->isLambda() and not cxxRecordDecl->isDependentType()};
+
+    return mForceShowPadding or GetInsightsOptions().UseShowPadding or
+           (isLambda and GetInsightsOptions().ShowLambdaLayout);
+}
+//-----------------------------------------------------------------------------
+
 // XXX: replace with std::format once it is available in all std-libs
 auto GetSpaces(std::string::size_type offset)
 {
@@ -3314,7 +5511,7 @@ void CodeGenerator::InsertArg(const FieldDecl* stmt)
 
     mOutputFormatHelper.Append(';');
 
-    if(GetInsightsOptions().UseShowPadding) {
+    if(ShowPadding(stmt->getParent())) {
         const auto* fieldClass   = stmt->getParent();
         const auto& recordLayout = GetRecordLayout(fieldClass);
         auto        effectiveFieldSize{GetGlobalAST().getTypeInfoInChars(type).Width.getQuantity()};
@@ -3588,7 +5785,7 @@ void CodeGenerator::InsertTemplate(const FunctionTemplateDecl* stmt, bool withSp
         }
 
         mOutputFormatHelper.AppendNewLine();
-        InsertArg(spec);
+        InsertTemplateSpecialization(stmt, spec, [&] { InsertArg(spec); });
         mOutputFormatHelper.AppendNewLine();
     }
 }
@@ -3702,6 +5899,10 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
     // Prevent a case like in #205 where the lambda appears twice.
     RETURN_IF(stmt->isLambda() and (mLambdaStack.empty() or (nullptr == mLambdaExpr)));
 
+    if(GetInsightsOptions().ShowNoexceptMoves) {
+        PushMoveAuditRecord(stmt);
+    }
+
     const auto* classTemplatePartialSpecializationDecl = dyn_cast_or_null<ClassTemplatePartialSpecializationDecl>(stmt);
     const auto* classTemplateSpecializationDecl        = dyn_cast_or_null<ClassTemplateSpecializationDecl>(stmt);
 
@@ -3778,7 +5979,7 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
         });
     }
 
-    if(GetInsightsOptions().UseShowPadding) {
+    if(ShowPadding(stmt)) {
         const auto& recordLayout = GetRecordLayout(stmt);
         mOutputFormatHelper.AppendNewLine(
             "  /* size: "sv, recordLayout.getSize(), ", align: "sv, recordLayout.getAlignment(), " */"sv);
@@ -3789,7 +5990,7 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
 
     mOutputFormatHelper.OpenScope();
 
-    if(GetInsightsOptions().UseShowPadding) {
+    if(ShowPadding(stmt)) {
         for(size_t offset{}; const auto& base : stmt->bases()) {
             const auto& baseRecordLayout = GetRecordLayout(base.getType()->getAsRecordDecl());
             const auto  baseVar          = StrCat("/* base ("sv, GetName(base.getType()), ")"sv);
@@ -3802,6 +6003,10 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
         }
     }
 
+    if(stmt->isLambda() and ShowPadding(stmt) and GetInsightsOptions().ShowLambdaLayout) {
+        InsertClosureSizeComment(stmt);
+    }
+
     UpdateCurrentPos(mCurrentFieldPos);
 
     OnceTrue        firstRecordDecl{};
@@ -4113,6 +6318,84 @@ void CodeGenerator::InsertArg(const SizeOfPackExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Collect all different local variables which are returned by return statements in \p stmt.
+static void CollectReturnedLocals(const Stmt* stmt, SmallVectorImpl<const VarDecl*>& locals)
+{
+    // A lambda has its own return statements
+    RETURN_IF(not stmt or isa<LambdaExpr>(stmt));
+
+    if(const auto* returnStmt = dyn_cast_or_null<ReturnStmt>(stmt)) {
+        if(const auto* vd = returnStmt->getNRVOCandidate(); vd and not llvm::is_contained(locals, vd)) {
+            locals.push_back(vd);
+        }
+    }
+
+    for(const auto* child : stmt->children()) {
+        CollectReturnedLocals(child, locals);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertNRVOComment(const FunctionDecl& stmt)
+{
+    RETURN_IF(not GetInsightsOptions().ShowCopyElision or not stmt.getReturnType()->isRecordType() or
+              stmt.getReturnType()->isDependentType() or isa_and_nonnull<CoroutineBodyStmt>(stmt.getBody()));
+
+    SmallVector<const VarDecl*, 4> locals{};
+    CollectReturnedLocals(stmt.getBody(), locals);
+
+    RETURN_IF(2 > locals.size());
+
+    mOutputFormatHelper.Append(" "sv, kwCCommentStartSpace, "no NRVO: returns different locals "sv);
+
+    for(OnceFalse needsComma{}; const auto* vd : locals) {
+        if(needsComma) {
+            mOutputFormatHelper.Append(", "sv);
+        }
+
+        mOutputFormatHelper.Append(GetName(*vd));
+    }
+
+    mOutputFormatHelper.Append(kwSpaceCCommentEnd);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertCopyElisionComment(const ReturnStmt* stmt)
+{
+    RETURN_IF(not GetInsightsOptions().ShowCopyElision);
+
+    const auto* retVal = stmt->getRetValue();
+    RETURN_IF(not retVal or not retVal->getType()->isRecordType() or retVal->isTypeDependent());
+
+    // A function returning a reference does not create an object
+    if(const auto* function = mFunctionReport.function; function and function->getReturnType()->isReferenceType()) {
+        return;
+    }
+
+    const auto* construct   = dyn_cast_or_null<CXXConstructExpr>(retVal->IgnoreImplicit());
+    const bool  isMoveOrCopy{construct and construct->getConstructor()->isCopyOrMoveConstructor() and
+                            not construct->isElidable()};
+    const bool  isMove{isMoveOrCopy and construct->getConstructor()->isMoveConstructor()};
+
+    const std::string_view elision = [&] {
+        if(const auto* nrvoVD = stmt->getNRVOCandidate()) {
+            if(nrvoVD->isNRVOVariable()) {
+                return "copy elision: NRVO"sv;
+            }
+
+            return ValueOr(not isMoveOrCopy or isMove, "no copy elision: implicit move"sv, "no copy elision: copy"sv);
+
+        } else if(isMoveOrCopy) {
+            return ValueOr(isMove, "no copy elision: move"sv, "no copy elision: copy"sv);
+        }
+
+        return "copy elision: guaranteed (prvalue)"sv;
+    }();
+
+    mOutputFormatHelper.Append(kwCCommentStartSpace, elision, kwSpaceCCommentEndSpace);
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const ReturnStmt* stmt)
 {
     LAMBDA_SCOPE_HELPER(ReturnStmt);
@@ -4120,13 +6403,16 @@ void CodeGenerator::InsertArg(const ReturnStmt* stmt)
     UpdateCurrentPos(mCurrentReturnPos);
 
     {  // dedicated scope to first clear everything found in the return statement. Then clear all others.
-        TemporaryDeclFinder temporaryFinder{*this, stmt->getRetValue(), true};
+        // A returned local is the returned object itself, Cfront must not copy it into a temporary first.
+        TemporaryDeclFinder temporaryFinder{*this, stmt->getRetValue(), not stmt->getNRVOCandidate()};
 
         mOutputFormatHelper.Append(kwReturn);
 
         if(const auto* retVal = stmt->getRetValue()) {
             mOutputFormatHelper.Append(' ');
 
+            InsertCopyElisionComment(stmt);
+
             if(not temporaryFinder.Found()) {
                 if(const auto* nrvoVD = stmt->getNRVOCandidate()) {
                     mOutputFormatHelper.Append(GetName(*nrvoVD));
@@ -4343,6 +6629,11 @@ void CodeGenerator::InsertArg(const Decl* stmt)
 {
     mLastDecl = stmt;
 
+    // A header declaration which goes to the file of -shared-output
+    if(InsertSharedDecl(stmt)) {
+        return;
+    }
+
 #define SUPPORTED_DECL(type)                                                                                           \
     if(isa<type>(stmt)) {                                                                                              \
         InsertArg(static_cast<const type*>(stmt));                                                                     \
@@ -4486,6 +6777,11 @@ void CodeGenerator::HandleLocalStaticNonTrivialClass(const VarDecl* stmt)
     const bool threadSafe{langOpts.ThreadsafeStatics and langOpts.CPlusPlus11 and
                           (stmt->isLocalVarDecl() /*|| NonTemplateInline*/) and not stmt->getTLSKind()};
 
+    if(GetInsightsOptions().ShowStaticInit and stmt->getLocation().isValid() and
+       not llvm::is_contained(gGuardedLocalStatics, std::pair{static_cast<const VarDecl*>(stmt), threadSafe})) {
+        gGuardedLocalStatics.emplace_back(stmt, threadSafe);
+    }
+
     const std::string internalVarName{BuildInternalVarName(GetName(*stmt))};
     const std::string compilerBoolVarName{StrCat(internalVarName, "Guard"sv)};
 
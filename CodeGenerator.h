@@ -81,6 +81,39 @@ public:
     void StartScope(bool funcStart);
     bool Return(OutputFormatHelper& ofm);
     bool EndScope(OutputFormatHelper& ofm, bool clear);
+
+    /// \brief Forget the scopes of a transformation which crashed, see \c ResetGeneratorState.
+    static void Reset() { scopeCounter = 0; }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Per-function counters collected while generating a function body.
+///
+/// The data is emitted as a comment after the closing brace of the function.
+struct FunctionReport
+{
+    const FunctionDecl* function{};  //!< The function which body is currently generated.
+
+    uint64_t allocations{};
+    uint64_t allocatedBytes{};
+    uint64_t deallocations{};
+    uint64_t indirectCalls{};
+    uint64_t devirtualizableCalls{};
+    uint64_t temporaries{};
+    uint64_t temporariesInLoops{};
+    uint64_t missedMoves{};
+    uint64_t pessimizingMoves{};
+
+    /// The findings of the move audit for this function. Maps a \c DeclRefExpr or a \c CallExpr to the finding.
+    llvm::DenseMap<const Expr*, std::string_view> moveAuditFindings{};
+    /// Whether the frame allocation of the coroutines called by this function can be elided.
+    llvm::DenseMap<const CallExpr*, std::string> haloFindings{};
+
+    bool empty() const
+    {
+        return (0 == allocations) and (0 == deallocations) and (0 == indirectCalls) and (0 == devirtualizableCalls) and
+               (0 == temporaries) and (0 == missedMoves) and (0 == pessimizingMoves);
+    }
 };
 
 /// \brief More or less the heart of C++ Insights.
@@ -202,6 +235,9 @@ public:
 
     virtual ~CodeGenerator() = default;
 
+    /// \brief Forget the counters of a transformation which crashed, see \c ResetGeneratorState.
+    static void ResetFunctionReport() { mFunctionReport = {}; }
+
 #define IGNORED_DECL(type)                                                                                             \
     virtual void InsertArg(const type*) {}
 #define IGNORED_STMT(type)                                                                                             \
@@ -280,6 +316,9 @@ public:
     void LifetimeAddExtended(const VarDecl*, const ValueDecl*);
     void EndLifetimeScope();
 
+    /// \brief Show the layout of the records generated by this generator, as \c -edu-show-padding does.
+    void ForceShowPadding() { mForceShowPadding = true; }
+
 protected:
     virtual bool InsertVarDecl(const VarDecl*) { return true; }
     virtual bool SkipSpaceAfterVarDecl() { return false; }
@@ -302,6 +341,31 @@ protected:
     /// - www.opensource.apple.com/source/libcppabi/libcppabi-14/src/cxa_guard.cxx
     void HandleLocalStaticNonTrivialClass(const VarDecl* stmt);
 
+    /// \brief Mark a heap allocation with its estimated size in bytes, if known.
+    void InsertAllocationComment(std::optional<uint64_t> bytes);
+    void InsertAllocationComment(const CXXNewExpr* stmt);
+    void InsertDeallocationComment();
+    /// \brief Tag a member call as direct, virtual or devirtualizable call.
+    void InsertDispatchComment(const CXXMemberCallExpr* stmt);
+    /// \brief Show name, type, size and end of lifetime of a temporary, which is either a \c MaterializeTemporaryExpr
+    /// or a \c CXXBindTemporaryExpr.
+    void InsertTemporaryComment(const Expr* stmt);
+    /// \brief Show whether the returned object is elided, moved or copied.
+    void InsertCopyElisionComment(const ReturnStmt* stmt);
+    /// \brief Flag functions which can never apply NRVO as they return different local objects.
+    void InsertNRVOComment(const FunctionDecl& stmt);
+    /// \brief Show the finding of the move audit for \p stmt, if there is one.
+    void InsertMoveAuditComment(const Expr* stmt);
+    /// \brief Show whether the frame allocation of the coroutine called by \p stmt can be elided.
+    void InsertHALOComment(const CallExpr* stmt);
+    /// \brief Show the counters collected in \ref mFunctionReport.
+    void InsertFunctionReport();
+    /// \brief Summarize the implicit operations the loop \p stmt executes with each iteration.
+    void InsertLoopCostComment(const Stmt* stmt);
+    bool ShowPadding(const RecordDecl* record) const;
+    /// \brief Flag a lambda closure which does not fit into the small buffer of \c std::function.
+    void InsertClosureSizeComment(const CXXRecordDecl* stmt);
+
     virtual void FormatCast(const std::string_view castName,
                             const QualType&        CastDestType,
                             const Expr*            SubExpr,
@@ -325,6 +389,13 @@ protected:
 
     void InsertTemplate(const FunctionTemplateDecl*, bool withSpec);
 
+    /// \brief Insert the specialization \p spec of \p tmpl with \p insert and account the generated code to \p tmpl.
+    void InsertTemplateSpecialization(const TemplateDecl* tmpl, const Decl* spec, void_func_ref insert);
+
+    /// \brief Refer to the copy of \p decl in the file of \c -shared-output, if it is a header declaration which can be
+    /// shared. A declaration the file does not have yet is added to it.
+    bool InsertSharedDecl(const Decl* decl);
+
     void InsertQualifierAndNameWithTemplateArgs(const DeclarationName& declName, const auto* stmt)
     {
         InsertQualifierAndName(declName, stmt->getQualifier(), stmt->hasTemplateKeyword());
@@ -452,6 +523,11 @@ protected:
     OutputFormatHelper* mOutputFormatHelperOutside{
         nullptr};                        //!< Helper output buffer for std::initializer_list expansion.
     bool mRequiresImplicitReturnZero{};  //!< Track whether this is a function with an imlpicit return 0.
+    static inline FunctionReport mFunctionReport{};  //!< Counters of the function body currently generated, shared
+                                                     //!< with the generators created for parts of it.
+    unsigned    mLoopDepth{};         //!< The nesting depth of loops at the currently generated statement.
+    const Stmt* mLoweredLoop{};       //!< A loop lowered from another one, which already shows the loop costs.
+    bool        mForceShowPadding{};  //!< Show the record layout regardless of \c -edu-show-padding.
     bool mSkipSemi{};
     ProcessingPrimaryTemplate mProcessingPrimaryTemplate{};
 };
@@ -547,6 +623,9 @@ public:
 
     ~CoroutinesCodeGenerator() override;
 
+    /// \brief Forget the opaque values of previous transformations, see \c ResetGeneratorState.
+    static void ResetState() { mOpaqueValues.clear(); }
+
     using CodeGenerator::InsertArg;
 
     void InsertArg(const ImplicitCastExpr* stmt) override;
@@ -587,6 +666,8 @@ private:
     std::string                       mFSMName{};
     CoroutineASTData                  mASTData{};
     llvm::DenseMap<const Stmt*, bool> mBinaryExprs{};
+    SmallVector<std::pair<const VarDecl*, bool>, 8>
+        mFrameLocals{};  ///! The locals hoisted into the frame and whether they live across a suspend point.
     static inline llvm::DenseMap<const Expr*, std::string>
         mOpaqueValues{};  ///! Keeps track of the current set of opaque value
 
@@ -657,6 +738,9 @@ struct __mptr
 
     static CfrontVtableData& VtableData();
 
+    /// \brief Forget the vtable layouts of previous transformations, see \c ResetGeneratorState.
+    static void ResetState();
+
 protected:
     bool InsertSemi() override { return std::exchange(mInsertSemi, true); }
 };
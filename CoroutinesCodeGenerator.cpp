@@ -41,6 +41,49 @@ QualType CoroutinesCodeGenerator::GetFramePointerType() const
 }
 //-----------------------------------------------------------------------------
 
+/// \brief List the locals hoisted into the frame \p frameName with their size and whether they live across a suspend
+/// point.
+static void InsertFrameLocals(OutputFormatHelper&                       ofm,
+                              std::string_view                          frameName,
+                              ArrayRef<std::pair<const VarDecl*, bool>> locals)
+{
+    RETURN_IF(locals.empty());
+
+    const auto& ctx = GetGlobalAST();
+    uint64_t    totalBytes{};
+    uint64_t    notCrossingBytes{};
+
+    ofm.AppendCommentNewLine("Locals hoisted into "sv, frameName, ":"sv);
+
+    for(const auto& [vd, livesAcrossSuspend] : locals) {
+        // A reference is stored as a pointer in the frame
+        const auto type  = vd->getType();
+        const auto bytes = static_cast<uint64_t>(
+            ctx.getTypeSizeInChars(type->isReferenceType() ? ctx.VoidPtrTy : type).getQuantity());
+
+        totalBytes += bytes;
+
+        if(not livesAcrossSuspend) {
+            notCrossingBytes += bytes;
+        }
+
+        ofm.AppendCommentNewLine(GetName(*vd),
+                                 ": "sv,
+                                 bytes,
+                                 " bytes, "sv,
+                                 livesAcrossSuspend ? "lives across a suspend point"sv
+                                                    : "does not live across a suspend point"sv);
+    }
+
+    if(notCrossingBytes) {
+        ofm.AppendCommentNewLine(
+            notCrossingBytes, " of "sv, totalBytes, " bytes of hoisted locals do not need to be in the frame"sv);
+    }
+
+    ofm.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
 CoroutinesCodeGenerator::~CoroutinesCodeGenerator()
 {
     RETURN_IF(not(mASTData.mFrameType and mASTData.mDoInsertInDtor));
@@ -51,8 +94,17 @@ CoroutinesCodeGenerator::~CoroutinesCodeGenerator()
 
     // Using the "normal" CodeGenerator here as this is only about inserting the made up coroutine-frame.
     CodeGeneratorVariant codeGenerator{ofm};
+
+    if(GetInsightsOptions().ShowCoroutineFrame) {
+        codeGenerator->ForceShowPadding();
+    }
+
     codeGenerator->InsertArg(mASTData.mFrameType);
 
+    if(GetInsightsOptions().ShowCoroutineFrame) {
+        InsertFrameLocals(ofm, mFrameName, mFrameLocals);
+    }
+
     // Insert the made-up struct before the function declaration
     mOutputFormatHelper.InsertAt(mPosBeforeFunc, ofm);
 }
@@ -414,6 +466,142 @@ public:
 };
 //-----------------------------------------------------------------------------
 
+/// \brief Find the locals of a coroutine body which live across a suspend point.
+///
+/// The analysis works on source order. A local lives from the end of its declaration to its last use or, if it has a
+/// destructor, to the end of its scope. A loop which starts within that range and does not contain the declaration
+/// extends the range to the end of the loop, as the next iteration uses the local again.
+class SuspendPointLiveness
+{
+    struct Local
+    {
+        const VarDecl* decl{};
+        SourceLocation start{};
+        SourceLocation scopeEnd{};
+        SourceLocation lastUse{};
+    };
+
+    struct Loop
+    {
+        SourceLocation repeatBegin{};  //!< The part of the loop which is executed with each iteration.
+        SourceLocation end{};
+    };
+
+    const SourceManager&           mSM{GetGlobalAST().getSourceManager()};
+    SmallVector<Local, 8>          mLocals{};
+    SmallVector<Loop, 4>           mLoops{};
+    SmallVector<SourceLocation, 4> mSuspends{};
+    SmallVector<SourceLocation, 8> mScopeEnds{};
+    const Stmt*                    mParent{};
+
+    bool IsBefore(SourceLocation a, SourceLocation b) const { return mSM.isBeforeInTranslationUnit(a, b); }
+
+    void AddLocal(const VarDecl* vd, SourceLocation start)
+    {
+        RETURN_IF(not vd or vd->isStaticLocal() or mScopeEnds.empty());
+
+        mLocals.push_back(Local{.decl = vd, .start = start, .scopeEnd = mScopeEnds.back()});
+    }
+
+    void Visit(const Stmt* stmt)
+    {
+        // A lambda has its own frame, if it is a coroutine at all.
+        RETURN_IF(not stmt or isa<LambdaExpr>(stmt));
+
+        const bool opensScope{
+            isa<CompoundStmt, ForStmt, CXXForRangeStmt, WhileStmt, DoStmt, IfStmt, SwitchStmt, CXXCatchStmt>(stmt)};
+
+        if(opensScope) {
+            mScopeEnds.push_back(stmt->getEndLoc());
+        }
+
+        if(const auto* forStmt = dyn_cast_or_null<ForStmt>(stmt)) {
+            const auto* init = forStmt->getInit();
+            mLoops.push_back(Loop{init ? init->getEndLoc() : forStmt->getBeginLoc(), forStmt->getEndLoc()});
+
+        } else if(const auto* rangeForStmt = dyn_cast_or_null<CXXForRangeStmt>(stmt)) {
+            mLoops.push_back(Loop{rangeForStmt->getBody()->getBeginLoc(), rangeForStmt->getEndLoc()});
+
+        } else if(isa<WhileStmt, DoStmt>(stmt)) {
+            mLoops.push_back(Loop{stmt->getBeginLoc(), stmt->getEndLoc()});
+
+        } else if(isa<CoroutineSuspendExpr>(stmt)) {
+            mSuspends.push_back(stmt->getEndLoc());
+
+        } else if(const auto* declStmt = dyn_cast_or_null<DeclStmt>(stmt)) {
+            for(const auto* decl : declStmt->decls()) {
+                const auto* vd = dyn_cast_or_null<VarDecl>(decl);
+
+                // The loop variable of a range-based for-loop starts a new life with each iteration.
+                if(const auto* rangeForStmt = dyn_cast_or_null<CXXForRangeStmt>(mParent);
+                   rangeForStmt and (rangeForStmt->getLoopVariable() == vd)) {
+                    AddLocal(vd, rangeForStmt->getBody()->getBeginLoc());
+
+                } else if(vd) {
+                    AddLocal(vd, vd->getEndLoc());
+                }
+            }
+
+        } else if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(stmt)) {
+            for(auto& local : mLocals) {
+                if((local.decl == declRef->getDecl()) and
+                   (local.lastUse.isInvalid() or IsBefore(local.lastUse, declRef->getLocation()))) {
+                    local.lastUse = declRef->getLocation();
+                }
+            }
+        }
+
+        const auto* parent = std::exchange(mParent, stmt);
+
+        for(const auto* child : stmt->children()) {
+            Visit(child);
+        }
+
+        mParent = parent;
+
+        if(opensScope) {
+            mScopeEnds.pop_back();
+        }
+    }
+
+    bool LivesAcrossSuspend(const Local& local) const
+    {
+        const bool     hasDtor{QualType::DK_none != local.decl->getType().isDestructedType()};
+        SourceLocation end{hasDtor ? local.scopeEnd : local.lastUse};
+
+        if(end.isInvalid()) {
+            return false;
+        }
+
+        // The loops are in source order, an extension by one loop is seen by the following ones.
+        for(const auto& loop : mLoops) {
+            if(IsBefore(local.start, loop.repeatBegin) and IsBefore(loop.repeatBegin, end) and
+               IsBefore(end, loop.end)) {
+                end = loop.end;
+            }
+        }
+
+        return ranges::any_of(mSuspends, [&](const SourceLocation& suspend) {
+            return IsBefore(local.start, suspend) and IsBefore(suspend, end);
+        });
+    }
+
+public:
+    explicit SuspendPointLiveness(const Stmt* body) { Visit(body); }
+
+    SmallVector<std::pair<const VarDecl*, bool>, 8> Get() const
+    {
+        SmallVector<std::pair<const VarDecl*, bool>, 8> ret{};
+
+        for(const auto& local : mLocals) {
+            ret.push_back({local.decl, LivesAcrossSuspend(local)});
+        }
+
+        return ret;
+    }
+};
+//-----------------------------------------------------------------------------
+
 void CoroutinesCodeGenerator::InsertCoroutine(const FunctionDecl& fd, const CoroutineBodyStmt* stmt)
 {
     mOutputFormatHelper.OpenScope();
@@ -479,6 +667,27 @@ void CoroutinesCodeGenerator::InsertCoroutine(const FunctionDecl& fd, const Coro
     mOutputFormatHelper.AppendCommentNewLine("Allocate the frame including the promise"sv);
     mOutputFormatHelper.AppendCommentNewLine("Note: The actual parameter new is __builtin_coro_size"sv);
 
+    if(GetInsightsOptions().ShowHALO) {
+        const auto* allocCall = dyn_cast_or_null<CallExpr>(stmt->getAllocate());
+        const auto* allocFn   = allocCall ? allocCall->getDirectCallee() : nullptr;
+
+        // The promise type can provide its own operator new, otherwise the global one is used.
+        if(const auto* newMethod = dyn_cast_or_null<CXXMethodDecl>(allocFn)) {
+            const auto text = StrCat("Allocation: "sv, GetName(*newMethod->getParent()), "::operator new from "sv);
+
+            InsertInstantiationPoint(GetSM(*newMethod), newMethod->getLocation(), text);
+        } else {
+            mOutputFormatHelper.AppendCommentNewLine("Allocation: global operator new"sv);
+        }
+
+        if(const auto blocker = GetHALOBlocker(fd)) {
+            mOutputFormatHelper.AppendCommentNewLine("HALO: not possible, "sv, *blocker);
+        } else {
+            mOutputFormatHelper.AppendCommentNewLine(
+                "HALO: possible for callers which destroy the coroutine before they return"sv);
+        }
+    }
+
     auto* coroFrameVar = Variable(CORO_FRAME_NAME, GetFramePointerType());
     auto* reicast      = ReinterpretCast(GetFramePointerType(), stmt->getAllocate());
 
@@ -499,6 +708,11 @@ void CoroutinesCodeGenerator::InsertCoroutine(const FunctionDecl& fd, const Coro
         InsertArg(ifStmt);
     }
 
+    // The analysis needs the body before the transformation reroutes the locals to the frame.
+    if(GetInsightsOptions().ShowCoroutineFrame) {
+        mFrameLocals = SuspendPointLiveness{stmt->getBody()}.Get();
+    }
+
     CoroutineASTTransformer{
         mASTData, mSuspendsCounter, const_cast<CoroutineBodyStmt*>(stmt), llvm::DenseMap<VarDecl*, MemberExpr*>{}};
 
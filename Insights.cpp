@@ -6,15 +6,33 @@
  ****************************************************************************/
 
 #include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <numeric>
+#include <optional>
 #include "clang/AST/ASTContext.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/PrecompiledPreamble.h"
+#include "clang/Lex/PreprocessingRecord.h"
 #include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Sema/Sema.h"
+#include "clang/Sema/TemplateInstCallback.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/VirtualFileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <vector>
@@ -23,6 +41,13 @@
 #include "DPrint.h"
 #include "Insights.h"
 #include "version.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif /* _WIN32 */
 //-----------------------------------------------------------------------------
 
 using namespace clang;
@@ -59,6 +84,212 @@ static llvm::cl::opt<bool>
     gUseLibCpp("use-libc++", llvm::cl::desc("Use libc++."sv), llvm::cl::init(false), llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
+static llvm::cl::opt<unsigned> gMaxOutputBytes(
+    "max-output-bytes",
+    llvm::cl::desc("Stop the transformation once the output exceeds this many bytes. 0 means no limit."sv),
+    llvm::cl::init(0),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gDeadlineMs(
+    "deadline-ms",
+    llvm::cl::desc("Stop parsing and the transformation once a translation unit takes longer than this many "
+                   "milliseconds. 0 means no deadline."sv),
+    llvm::cl::init(0),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gMaxMemoryMb(
+    "max-memory-mb",
+    llvm::cl::desc("Stop parsing and the transformation once the heap usage exceeds this many MiB. 0 means no "
+                   "limit."sv),
+    llvm::cl::init(0),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gForkServerMode(
+    "fork-server",
+    llvm::cl::desc("Read one request per line from <stdin> and transform each in a forked child process. A request "
+                   "is a source file path, optionally preceded by a client name and a priority, all separated by "
+                   "tabs. Each response is a line with the exit status, the size of the output, the size of the errors "
+                   "and the number of the request, followed by the output and the errors. The source files of the "
+                   "command line are not transformed. Their include blocks are precompiled once and used by each "
+                   "request for a file in the same directory with the same include block."sv),
+    llvm::cl::init(false),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gReusePreamble(
+    "reuse-preamble",
+    llvm::cl::desc("With -fork-server, precompile the include block of a source file once and reuse it for the "
+                   "following requests as long as it stays byte-identical."sv),
+    llvm::cl::init(false),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gForkServerJobs(
+    "fork-server-jobs",
+    llvm::cl::desc("With -fork-server, the number of requests transformed at the same time."sv),
+    llvm::cl::init(1),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gForkServerMaxQueue(
+    "fork-server-max-queue",
+    llvm::cl::desc("With -fork-server, reject a request while this many others wait for a child. 0 means no "
+                   "limit."sv),
+    llvm::cl::init(0),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gCancelOnSignal(
+    "cancel-on-signal",
+    llvm::cl::desc("Stop parsing and the transformation cleanly on the first SIGINT or SIGTERM, for example when a "
+                   "newer request superseded this run."sv),
+    llvm::cl::init(false),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::list<std::string> gOptionSets(
+    "option-set",
+    llvm::cl::desc("Transform the parsed source once more with the given space separated options enabled in addition "
+                   "to the others. Can be given multiple times, each output follows the regular one."sv),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::list<std::string> gStdFanOut(
+    "std-fan-out",
+    llvm::cl::desc("Transform the source once for each of the given comma separated standards, like c++17,c++20, or "
+                   "argument lists starting with a dash, in parallel. A summary of the top-level declarations which "
+                   "transform differently follows the outputs."sv),
+    llvm::cl::CommaSeparated,
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gSharedOutputPath(
+    "shared-output",
+    llvm::cl::desc("Generate the declarations from headers which are equal in each translation unit only once, into "
+                   "the given file. The outputs refer to them. Several runs, also with different options, can use "
+                   "the same file at the same time."sv),
+    llvm::cl::value_desc("filename"),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gIncludeCostTimes(
+    "include-cost-times",
+    llvm::cl::desc("With -show-include-costs, show the time each direct include takes. Turn it off for a "
+                   "reproducible output."sv),
+    llvm::cl::init(true),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+#ifdef INSIGHTS_DEBUG
+static llvm::cl::opt<std::string> gDebugCrashIn(
+    "debug-crash-in",
+    llvm::cl::desc("Crash while transforming the top-level declaration with the given name, to test the crash "
+                   "recovery."sv),
+    llvm::cl::value_desc("name"),
+    llvm::cl::Hidden,
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+#endif /* INSIGHTS_DEBUG */
+
+static llvm::cl::opt<std::string> gHeaderArchive(
+    "header-archive",
+    llvm::cl::desc("Serve the include directories packed into the given file by scripts/pack-headers.py from memory. "
+                   "Builds with INSIGHTS_HEADER_ARCHIVE use the archive next to the binary by default."sv),
+    llvm::cl::value_desc("filename"),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+/// \brief Whether a transformation ends with the digests of its top-level declarations, see \c -std-fan-out.
+static bool                       gEmitDeclDigests{};
+static constexpr std::string_view gDeclDigestsTitle{"\n/* Declaration digests: */\n"sv};
+//-----------------------------------------------------------------------------
+
+/// \brief The exit status of a run which was stopped by one of the resource limits.
+static constexpr int gResourceLimitExitCode{3};
+/// \brief The exit status of a run which was cancelled with \c -cancel-on-signal.
+static constexpr int gCancelledExitCode{4};
+/// \brief The exit status of a run in which at least one translation unit crashed.
+static constexpr int gCrashedExitCode{5};
+
+/// \brief The top-level declaration the transformation is busy with, named in the report of a crash.
+static const Decl* gCurrentTopLevelDecl{};
+static bool        gCrashed{};
+
+/// \brief When the current translation unit started, see \c -deadline-ms.
+static std::chrono::steady_clock::time_point gStartTime{};
+
+/// \brief Set from the signal handler installed for \c -cancel-on-signal.
+static std::atomic<bool> gCancelled{};
+
+/// \brief Why the current translation unit was stopped early, if it was. Reset for each translation unit.
+static std::optional<std::string_view> gStopReason{};
+/// \brief Whether any translation unit of this run was stopped early.
+static bool gStoppedEarly{};
+//-----------------------------------------------------------------------------
+
+/// \brief Check for a cancellation and the resource limits, \c -max-output-bytes only during the transformation.
+static bool RunMustStop(bool maxOutputReached = false)
+{
+    if(gStopReason.has_value()) {
+        return true;
+    }
+
+    if(gCancelled) {
+        gStopReason = "cancelled"sv;
+
+    } else if(maxOutputReached) {
+        gStopReason = "-max-output-bytes exceeded"sv;
+
+    } else if(gDeadlineMs and ((std::chrono::steady_clock::now() - gStartTime) >
+                               std::chrono::milliseconds{gDeadlineMs.getValue()})) {
+        gStopReason = "-deadline-ms exceeded"sv;
+
+    } else if(gMaxMemoryMb and (llvm::sys::Process::GetMallocUsage() > (size_t{gMaxMemoryMb.getValue()} << 20))) {
+        gStopReason = "-max-memory-mb exceeded"sv;
+    }
+
+    gStoppedEarly |= gStopReason.has_value();
+
+    return gStopReason.has_value();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Interrupt Sema once the run is cancelled or \c -deadline-ms or \c -max-memory-mb is exceeded.
+///
+/// A fatal error makes Sema refuse further template instantiations and the preprocessor skip further includes. The
+/// parser then only finishes the main file, and the transformation stops right away.
+static void StopSemaIfRunMustStop(SourceLocation loc = {})
+{
+    RETURN_IF(gStopReason.has_value() or not RunMustStop());
+
+    auto& diags = GetGlobalCI().getDiagnostics();
+    diags.Report(loc, diags.getCustomDiagID(DiagnosticsEngine::Fatal, "%0, stopping"))
+        << StringRef{gStopReason.value()};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Check the limits before each template instantiation.
+///
+/// A runaway instantiation inside a single declaration never returns to one of the hooks of the \c ASTConsumer
+/// before it is done. Sema reports each instantiation it starts to this callback, which can stop it right there.
+class LimitsInstantiationCallback final : public TemplateInstantiationCallback
+{
+public:
+    void initialize(const Sema& /*sema*/) override {}
+    void finalize(const Sema& /*sema*/) override {}
+
+    void atTemplateBegin(const Sema& /*sema*/, const Sema::CodeSynthesisContext& inst) override
+    {
+        StopSemaIfRunMustStop(inst.PointOfInstantiation);
+    }
+
+    void atTemplateEnd(const Sema& /*sema*/, const Sema::CodeSynthesisContext& /*inst*/) override {}
+};
+//-----------------------------------------------------------------------------
+
 #define INSIGHTS_OPT(option, name, deflt, description, category)                                                       \
     static llvm::cl::opt<bool, true> g##name(option,                                                                   \
                                              llvm::cl::desc(std::string_view{description}),                            \
@@ -71,6 +302,83 @@ static llvm::cl::opt<bool>
 #include "InsightsOptions.def"
 //-----------------------------------------------------------------------------
 
+/// \brief Enable the options named in \p optionSet, see \c -option-set.
+///
+/// \returns The first name which is not an option of C++ Insights, if any.
+static std::optional<StringRef> ApplyOptionSet(StringRef optionSet)
+{
+    SmallVector<StringRef, 8> names{};
+    optionSet.split(names, ' ', -1, false);
+
+    for(auto name : names) {
+        name = name.ltrim('-');
+
+        bool* value{};
+
+#define INSIGHTS_OPT(option, member, deflt, description, category)                                                    \
+    if(option == name) {                                                                                               \
+        value = &gInsightsOptions.member;                                                                              \
+    }
+
+#include "InsightsOptions.def"
+
+        if(nullptr == value) {
+            return name;
+        }
+
+        *value = true;
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the options on the command line or one of the \c -option-set entries enable \p option.
+static bool AnyOptionSetEnables(bool InsightsOptions::*option)
+{
+    const auto options = GetInsightsOptions();
+    bool       enabled = options.*option;
+
+    for(const auto& optionSet : gOptionSets) {
+        ApplyOptionSet(optionSet);
+        enabled = enabled or (GetInsightsOptions().*option);
+        gInsightsOptions = options;
+    }
+
+    return enabled;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Enable the options which other options build upon.
+static void EnableDependentOptions()
+{
+    if(GetInsightsOptions().ShowCoroutineFrame) {
+        gInsightsOptions.ShowCoroutineTransformation = true;
+    }
+
+    if(GetInsightsOptions().UseShow2C) {
+        if(GetInsightsOptions().ShowCoroutineTransformation) {
+            gInsightsOptions.UseShow2C = false;
+        } else {
+            gInsightsOptions.ShowLifetime = true;
+        }
+    }
+
+    if(GetInsightsOptions().ShowLifetime) {
+        gInsightsOptions.UseShowInitializerList = true;
+    }
+}
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned, true> gLambdaSBOSize(
+    "edu-lambda-sbo-size",
+    llvm::cl::desc("The small buffer size in bytes -edu-show-lambda-layout compares closures against. The default "
+                   "of 0 uses the one of std::function."sv),
+    llvm::cl::location(gInsightsOptions.LambdaSBOSize),
+    llvm::cl::init(0),
+    llvm::cl::cat(gInsightEduCategory));
+//-----------------------------------------------------------------------------
+
 static const ASTContext* gAST{};
 const ASTContext&        GetGlobalAST()
 {
@@ -87,6 +395,13 @@ const CompilerInstance&        GetGlobalCI()
 
 namespace clang::insights {
 std::string EmitGlobalVariableCtors();
+std::string EmitCostlyImplicitCasts();
+std::string EmitNoexceptMoveAudit();
+std::string EmitStaticInitReport();
+std::string EmitTemplateCostReport();
+std::string EmitICFCandidates();
+void        ResetGeneratorState();
+bool        OpenSharedOutput(StringRef path);
 
 using GlobalInsertMap = std::pair<bool, std::string_view>;
 
@@ -164,166 +479,1631 @@ public:
     }
 };
 
-class CppInsightASTConsumer final : public ASTConsumer
+/// \brief Collect what \ref FindIncludes collects from the preprocessing record of an AST file passed as input.
+///
+/// An AST file is not preprocessed again, the record is all that is left of the directives. It exists only if the
+/// AST file was created with \c -Xclang \c -detailed-preprocessing-record.
+static void FindIncludesInPreprocessingRecord(SourceManager& sm, Preprocessor& pp, std::vector<IncludeData>& incData)
 {
-    Rewriter&                 mRewriter;
-    std::vector<IncludeData>& mIncludes;
+    auto* record = pp.getPreprocessingRecord();
+
+    if(nullptr == record) {
+        return;
+    }
+
+    for(PreprocessedEntity* entity : *record) {
+        if(const auto* inclusion = dyn_cast_or_null<InclusionDirective>(entity)) {
+            auto expansionLoc = sm.getExpansionLoc(inclusion->getSourceRange().getBegin());
+
+            if(expansionLoc.isInvalid() or sm.isInSystemHeader(expansionLoc)) {
+                continue;
+            }
+
+            if(inclusion->wasInQuotes()) {
+                incData.emplace_back(expansionLoc, StrCat("#include \""sv, inclusion->getFileName(), "\"\n"sv));
 
-public:
-    explicit CppInsightASTConsumer(Rewriter& rewriter, std::vector<IncludeData>& includes)
-    : ASTConsumer{}
-    , mRewriter{rewriter}
-    , mIncludes{includes}
-    {
-        if(GetInsightsOptions().UseShow2C) {
-            if(GetInsightsOptions().ShowCoroutineTransformation) {
-                gInsightsOptions.UseShow2C = false;
             } else {
-                gInsightsOptions.ShowLifetime = true;
+                incData.emplace_back(expansionLoc, StrCat("#include <"sv, inclusion->getFileName(), ">\n"sv));
             }
-        }
 
-        if(GetInsightsOptions().ShowLifetime) {
-            gInsightsOptions.UseShowInitializerList = true;
+        } else if(const auto* macroDef = dyn_cast_or_null<MacroDefinitionRecord>(entity)) {
+            const auto loc  = macroDef->getLocation();
+            const auto name = macroDef->getName()->getName();
+
+            if(sm.isWrittenInMainFile(loc) and name.starts_with("INSIGHTS_"sv)) {
+                incData.emplace_back(loc, StrCat("#define "sv, name, "\n"sv));
+            }
         }
     }
+}
 
-    void HandleTranslationUnit(ASTContext& context) override
-    {
-        gAST     = &context;
-        auto& sm = context.getSourceManager();
+/// \brief The cost of a header the main file includes directly, see \ref IncludeCosts.
+struct IncludeCost
+{
+    std::string                         directive{};
+    FileID                              fileId{};  //!< Invalid, if the header was skipped as already included.
+    uint64_t                            files{};
+    uint64_t                            bytes{};
+    uint64_t                            decls{};
+    std::chrono::steady_clock::duration time{};
+    bool                                referenced{};
+};
+//-----------------------------------------------------------------------------
 
-        auto isExpansionInSystemHeader = [&sm](const Decl* d) {
-            auto expansionLoc = sm.getExpansionLoc(d->getLocation());
+/// \brief Find the header the main file includes directly which brings \p loc in.
+static FileID GetDirectInclude(const SourceManager& sm, SourceLocation loc)
+{
+    for(FileID fileId = sm.getFileID(sm.getExpansionLoc(loc)); fileId.isValid();) {
+        const auto includeLoc = sm.getIncludeLoc(fileId);
 
-            return expansionLoc.isInvalid() or sm.isInSystemHeader(expansionLoc);
-        };
+        if(includeLoc.isInvalid()) {
+            break;
 
-        const auto& mainFileId = sm.getMainFileID();
+        } else if(sm.isWrittenInMainFile(includeLoc)) {
+            return fileId;
+        }
 
-        mRewriter.ReplaceText({sm.getLocForStartOfFile(mainFileId), sm.getLocForEndOfFile(mainFileId)}, "");
+        fileId = sm.getFileID(includeLoc);
+    }
 
-        OutputFormatHelper   outputFormatHelper{};
-        CodeGeneratorVariant codeGenerator{outputFormatHelper};
+    return {};
+}
+//-----------------------------------------------------------------------------
 
-        auto include = mIncludes.begin();
+static void MarkIncludeReferenced(const SourceManager& sm, std::vector<IncludeCost>& costs, SourceLocation loc)
+{
+    RETURN_IF(loc.isInvalid());
 
-        auto insertBlankLineIfRequired = [&](std::optional<SourceLocation>& lastLoc, SourceLocation nextLoc) {
-            if(lastLoc.has_value() and
-               (2 <= (sm.getSpellingLineNumber(nextLoc) - sm.getSpellingLineNumber(lastLoc.value())))) {
-                outputFormatHelper.AppendNewLine();
-            }
+    if(const auto fileId = GetDirectInclude(sm, loc); fileId.isValid()) {
+        if(auto iter = std::ranges::find(costs, fileId, &IncludeCost::fileId); iter != costs.end()) {
+            iter->referenced = true;
+        }
+    }
+}
+//-----------------------------------------------------------------------------
 
-            lastLoc = nextLoc;
-        };
+/// \brief Measure the files, bytes and time each direct include of the main file costs.
+///
+/// A header is entered with \c FileChanged after its \c InclusionDirective. Everything that is entered until the
+/// matching exit belongs to the direct include of the main file. As the parser pulls its tokens from the
+/// preprocessor, the time in between covers lexing and parsing of the header.
+class IncludeCosts : public PPCallbacks
+{
+    SourceManager&                        mSm;
+    std::vector<IncludeCost>&             mCosts;
+    unsigned                              mDepth{};
+    bool                                  mPendingInclude{};
+    std::chrono::steady_clock::time_point mStart{};
 
-        for(std::optional<SourceLocation> lastLoc{}; const auto* d : context.getTranslationUnitDecl()->decls()) {
-            if(isExpansionInSystemHeader(d)) {
-                continue;
-            }
+public:
+    IncludeCosts(SourceManager& sm, std::vector<IncludeCost>& costs)
+    : PPCallbacks{}
+    , mSm{sm}
+    , mCosts{costs}
+    {
+    }
 
-            // includes before this decl
-            for(; (mIncludes.end() != include) and (include->first < d->getLocation()); include = std::next(include)) {
-                insertBlankLineIfRequired(lastLoc, include->first);
-                outputFormatHelper.Append(include->second);
-            }
+    void InclusionDirective(SourceLocation hashLoc,
+                            const Token& /*IncludeTok*/,
+                            StringRef fileName,
+                            bool      isAngled,
+                            CharSourceRange /*FilenameRange*/,
+                            OptionalFileEntryRef /*file*/,
+                            StringRef /*SearchPath*/,
+                            StringRef /*RelativePath*/,
+                            const Module* /*Imported*/,
+                            SrcMgr::CharacteristicKind /*FileType*/) override
+    {
+        RETURN_IF(0 != mDepth or not mSm.isWrittenInMainFile(hashLoc));
 
-            // ignore includes inside this decl
-            include = std::find_if_not(include, mIncludes.end(), [&](auto& inc) {
-                return ((inc.first >= d->getLocation()) and (inc.first <= d->getEndLoc()));
-            });
+        if(isAngled) {
+            mCosts.push_back({StrCat("#include <"sv, fileName, ">"sv)});
+        } else {
+            mCosts.push_back({StrCat("#include \""sv, fileName, "\""sv)});
+        }
 
-            if(isa<LinkageSpecDecl>(d) and d->isImplicit()) {
-                continue;
+        mPendingInclude = true;
+    }
 
-                // Only handle explicit specializations here. Implicit ones are handled by the `VarTemplateDecl`
-                // itself.
-            } else if(const auto* vdspec = dyn_cast_or_null<VarTemplateSpecializationDecl>(d);
-                      vdspec and (TSK_ExplicitSpecialization != vdspec->getSpecializationKind())) {
-                continue;
+    void FileChanged(SourceLocation                loc,
+                     FileChangeReason              reason,
+                     SrcMgr::CharacteristicKind /*FileType*/,
+                     FileID /*PrevFID*/) override
+    {
+        if(EnterFile == reason) {
+            const auto fileId = mSm.getFileID(loc);
+
+            if(0 == mDepth) {
+                // Only a header included from the main file starts a new entry, not the predefines buffer
+                if(not mPendingInclude or not mSm.isWrittenInMainFile(mSm.getIncludeLoc(fileId))) {
+                    return;
+                }
+
+                mPendingInclude      = false;
+                mCosts.back().fileId = fileId;
+                mStart               = std::chrono::steady_clock::now();
             }
 
-            insertBlankLineIfRequired(lastLoc, d->getLocation());
-
-            codeGenerator->InsertArg(d);
-        }
+            ++mDepth;
+            ++mCosts.back().files;
 
-        std::string insightsIncludes{};
+            if(const auto buffer = mSm.getBufferOrNone(fileId)) {
+                mCosts.back().bytes += buffer->getBufferSize();
+            }
 
-        if(GetInsightsOptions().ShowCoroutineTransformation) {
-            insightsIncludes.append(
-                R"(/*************************************************************************************
- * NOTE: The coroutine transformation you've enabled is a hand coded transformation! *
- *       Most of it is _not_ present in the AST. What you see is an approximation.   *
- *************************************************************************************/
-)"sv);
-        } else if(GetInsightsOptions().UseShow2C or GetInsightsOptions().ShowLifetime) {
-            insightsIncludes.append(
-                R"(/*************************************************************************************
- * NOTE: This an educational hand-rolled transformation. Things can be incorrect or  *
- * buggy.                                                                            *
- *************************************************************************************/
-)"sv);
-        }
+        } else if((ExitFile == reason) and (0 != mDepth)) {
+            --mDepth;
 
-        // Check whether we had static local variables which we transformed. Then for the placement-new we need to
-        // include the header <new>.
-        std::string inserts{};
-        for(const auto& [active, value] : gGlobalInserts) {
-            if(not active) {
-                continue;
+            if(0 == mDepth) {
+                mCosts.back().time += std::chrono::steady_clock::now() - mStart;
             }
-
-            inserts.append(value);
-            inserts.append("\n"sv);
         }
+    }
 
-        if(not inserts.empty()) {
-            insightsIncludes.append(inserts);
-            insightsIncludes.append("\n");
+    void FileSkipped(const FileEntryRef& /*SkippedFile*/,
+                     const Token& /*FilenameTok*/,
+                     SrcMgr::CharacteristicKind /*FileType*/) override
+    {
+        if(0 == mDepth) {
+            mPendingInclude = false;
         }
+    }
 
-        outputFormatHelper.InsertAt(0, insightsIncludes);
-
-        mRewriter.InsertText(sm.getLocForStartOfFile(mainFileId), outputFormatHelper.GetString());
-
-        if(GetInsightsOptions().UseShow2C) {
-            const auto& fileEntry = sm.getFileEntryForID(mainFileId);
-            auto        cxaStart  = EmitGlobalVariableCtors();
-            const auto  cxaLoc    = sm.translateFileLineCol(fileEntry, fileEntry->getSize(), 1);
+    void MacroExpands(const Token& /*MacroNameTok*/,
+                      const MacroDefinition& md,
+                      SourceRange            range,
+                      const MacroArgs* /*Args*/) override
+    {
+        RETURN_IF(not mSm.isWrittenInMainFile(mSm.getExpansionLoc(range.getBegin())));
 
-            mRewriter.InsertText(cxaLoc, cxaStart);
+        if(const auto* macroInfo = md.getMacroInfo()) {
+            MarkIncludeReferenced(mSm, mCosts, macroInfo->getDefinitionLoc());
         }
     }
 };
 //-----------------------------------------------------------------------------
 
-class CppInsightFrontendAction final : public ASTFrontendAction
+/// \brief Find the declarations of the direct includes the main file refers to.
+class IncludeUseFinder : public RecursiveASTVisitor<IncludeUseFinder>
 {
-    Rewriter                 mRewriter{};
-    std::vector<IncludeData> mIncludes{};
+    const SourceManager&      mSm;
+    std::vector<IncludeCost>& mCosts;
+
+    void Mark(const Decl* decl)
+    {
+        if(decl) {
+            MarkIncludeReferenced(mSm, mCosts, decl->getLocation());
+        }
+    }
 
 public:
-    CppInsightFrontendAction() = default;
-    void EndSourceFileAction() override
+    IncludeUseFinder(const SourceManager& sm, std::vector<IncludeCost>& costs)
+    : mSm{sm}
+    , mCosts{costs}
     {
-        mRewriter.getEditBuffer(mRewriter.getSourceMgr().getMainFileID()).write(llvm::outs());
     }
 
-    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& CI, StringRef /*file*/) override
+    bool VisitDeclRefExpr(const DeclRefExpr* expr)
     {
-        gCI = &CI;
+        Mark(expr->getDecl());
+        return true;
+    }
 
-        Preprocessor& pp = CI.getPreprocessor();
-        pp.addPPCallbacks(std::make_unique<FindIncludes>(CI.getSourceManager(), pp, mIncludes));
+    bool VisitMemberExpr(const MemberExpr* expr)
+    {
+        Mark(expr->getMemberDecl());
+        return true;
+    }
 
-        mRewriter.setSourceMgr(CI.getSourceManager(), CI.getLangOpts());
-        return std::make_unique<CppInsightASTConsumer>(mRewriter, mIncludes);
+    bool VisitCXXConstructExpr(const CXXConstructExpr* expr)
+    {
+        Mark(expr->getConstructor());
+        return true;
     }
-};
-//-----------------------------------------------------------------------------
 
-#include "clang/Basic/Version.h"
+    bool VisitTypeLoc(TypeLoc typeLoc)
+    {
+        const auto* type = typeLoc.getTypePtr();
+
+        if(const auto* typedefType = dyn_cast<TypedefType>(type)) {
+            Mark(typedefType->getDecl());
+
+        } else if(const auto* tmplSpecType = dyn_cast<TemplateSpecializationType>(type)) {
+            Mark(tmplSpecType->getTemplateName().getAsTemplateDecl());
+
+        } else {
+            Mark(type->getAsTagDecl());
+        }
+
+        return true;
+    }
+};
+//-----------------------------------------------------------------------------
+
+static std::string EmitIncludeCostReport(ASTContext& context, const std::vector<IncludeCost>& includeCosts)
+{
+    if(includeCosts.empty()) {
+        return {};
+    }
+
+    // The measurement belongs to the parse, which each option set reports. Count the uses into a copy of it.
+    auto        costs = includeCosts;
+    const auto& sm    = context.getSourceManager();
+
+    IncludeUseFinder useFinder{sm, costs};
+
+    for(auto* d : context.getTranslationUnitDecl()->decls()) {
+        if(const auto fileId = GetDirectInclude(sm, d->getLocation()); fileId.isValid()) {
+            if(auto iter = std::ranges::find(costs, fileId, &IncludeCost::fileId); iter != costs.end()) {
+                ++iter->decls;
+            }
+
+        } else if(sm.isWrittenInMainFile(sm.getExpansionLoc(d->getLocation()))) {
+            useFinder.TraverseDecl(d);
+        }
+    }
+
+    OutputFormatHelper ofm{};
+    ofm.AppendNewLine();
+    ofm.AppendCommentNewLine("Include costs:"sv);
+
+    for(const auto& e : costs) {
+        if(e.fileId.isInvalid()) {
+            ofm.AppendCommentNewLine(e.directive, ": already included"sv);
+            continue;
+        }
+
+        const auto time = [&] {
+            if(gIncludeCostTimes) {
+                return StrCat(", time: "sv,
+                              std::chrono::duration_cast<std::chrono::microseconds>(e.time).count(),
+                              " us"sv);
+            }
+
+            return std::string{};
+        }();
+
+        ofm.AppendCommentNewLine(e.directive,
+                                 ": files: "sv,
+                                 e.files,
+                                 ", bytes: "sv,
+                                 e.bytes,
+                                 ", top-level decls: "sv,
+                                 e.decls,
+                                 time,
+                                 e.referenced ? ""sv : ", not referenced by the main file"sv);
+    }
+
+    return ofm.GetString();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Name a top-level declaration in the digests by its kind, its qualified name and its type.
+///
+/// The type tells overloads and specializations apart. The line does not belong to the name, a declaration has the
+/// same name in all variants of \c -std-fan-out.
+static std::string DeclDigestName(const Decl* decl)
+{
+    std::string name{decl->getDeclKindName()};
+
+    if(const auto* nd = dyn_cast_or_null<NamedDecl>(decl)) {
+        name.append(StrCat(" "sv, nd->getQualifiedNameAsString()));
+    }
+
+    if(const auto* td = dyn_cast_or_null<TemplateDecl>(decl)) {
+        decl = td->getTemplatedDecl();
+    }
+
+    if(const auto* vd = dyn_cast_or_null<ValueDecl>(decl)) {
+        name.append(StrCat(" "sv, vd->getType().getAsString()));
+
+    } else if(const auto* td = dyn_cast_or_null<TypeDecl>(decl); td and td->getTypeForDecl()) {
+        name.append(StrCat(" "sv, QualType{td->getTypeForDecl(), 0}.getAsString()));
+    }
+
+    return name;
+}
+//-----------------------------------------------------------------------------
+
+static std::string EmitDeclDigests(ArrayRef<std::pair<std::string, size_t>> digests)
+{
+    std::string ret{gDeclDigestsTitle};
+
+    for(const auto& [decl, digest] : digests) {
+        ret.append(StrCat("/* "sv, llvm::utohexstr(digest), " "sv, decl, " */\n"sv));
+    }
+
+    return ret;
+}
+//-----------------------------------------------------------------------------
+
+class CppInsightASTConsumer final : public ASTConsumer
+{
+    Rewriter&                 mRewriter;
+    std::vector<IncludeData>& mIncludes;
+    std::vector<IncludeCost>& mIncludeCosts;
+    std::vector<std::string>& mOptionSetOutputs;
+
+public:
+    explicit CppInsightASTConsumer(Rewriter&                 rewriter,
+                                   std::vector<IncludeData>& includes,
+                                   std::vector<IncludeCost>& includeCosts,
+                                   std::vector<std::string>& optionSetOutputs)
+    : ASTConsumer{}
+    , mRewriter{rewriter}
+    , mIncludes{includes}
+    , mIncludeCosts{includeCosts}
+    , mOptionSetOutputs{optionSetOutputs}
+    {
+        EnableDependentOptions();
+    }
+
+    bool HandleTopLevelDecl(DeclGroupRef /*decls*/) override
+    {
+        StopSemaIfRunMustStop();
+        return true;
+    }
+
+    void HandleTagDeclDefinition(TagDecl* /*decl*/) override { StopSemaIfRunMustStop(); }
+
+    void HandleCXXImplicitFunctionInstantiation(FunctionDecl* /*decl*/) override { StopSemaIfRunMustStop(); }
+
+    void HandleTranslationUnit(ASTContext& context) override
+    {
+        gAST = &context;
+
+        SmallVector<InsightsOptions, 4> optionSets{GetInsightsOptions()};
+
+        for(const auto& optionSet : gOptionSets) {
+            gInsightsOptions = optionSets.front();
+            ApplyOptionSet(optionSet);
+            EnableDependentOptions();
+            optionSets.push_back(GetInsightsOptions());
+        }
+
+        // The noexcept move audit lets Sema resolve the exception specifications of the implicit members clang already
+        // declared, which changes their types. Run it last, so that only it sees what it resolved. What the code
+        // generators replace in the AST is put back before each pass, see ResetGeneratorState.
+        SmallVector<size_t, 4> order(optionSets.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_partition(order, [&](size_t idx) { return not optionSets[idx].ShowNoexceptMoves; });
+
+        mOptionSetOutputs.resize(gOptionSets.size());
+
+        for(const auto idx : order) {
+            gInsightsOptions = optionSets[idx];
+
+            // Nothing a previous transformation collected may end up in this one
+            ResetGeneratorState();
+
+            for(auto& [active, value] : gGlobalInserts) {
+                active = false;
+            }
+
+            if(GetInsightsOptions().UseShow2C) {
+                EnableGlobalInsert(FuncCxaStart);
+                EnableGlobalInsert(FuncCxaAtExit);
+            }
+
+            if(0 == idx) {
+                Transform(context, mRewriter);
+                continue;
+            }
+
+            Rewriter rewriter{context.getSourceManager(), context.getLangOpts()};
+            Transform(context, rewriter);
+
+            llvm::raw_string_ostream out{mOptionSetOutputs[idx - 1]};
+            rewriter.getEditBuffer(context.getSourceManager().getMainFileID()).write(out);
+        }
+
+        // The AST goes away with this translation unit, restore what the last pass replaced in it before that
+        ResetGeneratorState();
+
+        gInsightsOptions = optionSets.front();
+    }
+
+private:
+    void Transform(ASTContext& context, Rewriter& rewriter)
+    {
+        auto& sm = context.getSourceManager();
+
+        auto isExpansionInSystemHeader = [&sm](const Decl* d) {
+            auto expansionLoc = sm.getExpansionLoc(d->getLocation());
+
+            return expansionLoc.isInvalid() or sm.isInSystemHeader(expansionLoc);
+        };
+
+        const auto& mainFileId = sm.getMainFileID();
+
+        rewriter.ReplaceText({sm.getLocForStartOfFile(mainFileId), sm.getLocForEndOfFile(mainFileId)}, "");
+
+        OutputFormatHelper   outputFormatHelper{};
+        CodeGeneratorVariant codeGenerator{outputFormatHelper};
+
+        // The output is cut at the limit as it grows, not only after a top-level declaration
+        outputFormatHelper.SetMaxSize(gMaxOutputBytes);
+
+        auto include = mIncludes.begin();
+
+        SmallVector<std::pair<std::string, size_t>, 16> declDigests{};
+        llvm::StringMap<unsigned>                       declDigestNames{};
+
+        auto insertBlankLineIfRequired = [&](std::optional<SourceLocation>& lastLoc, SourceLocation nextLoc) {
+            if(lastLoc.has_value() and
+               (2 <= (sm.getSpellingLineNumber(nextLoc) - sm.getSpellingLineNumber(lastLoc.value())))) {
+                outputFormatHelper.AppendNewLine();
+            }
+
+            lastLoc = nextLoc;
+        };
+
+        for(std::optional<SourceLocation> lastLoc{}; const auto* d : context.getTranslationUnitDecl()->decls()) {
+            if(RunMustStop(outputFormatHelper.MaxSizeReached())) {
+                break;
+            }
+
+            if(isExpansionInSystemHeader(d)) {
+                continue;
+            }
+
+            // includes before this decl
+            for(; (mIncludes.end() != include) and (include->first < d->getLocation()); include = std::next(include)) {
+                insertBlankLineIfRequired(lastLoc, include->first);
+                outputFormatHelper.Append(include->second);
+            }
+
+            // ignore includes inside this decl
+            include = std::find_if_not(include, mIncludes.end(), [&](auto& inc) {
+                return ((inc.first >= d->getLocation()) and (inc.first <= d->getEndLoc()));
+            });
+
+            if(isa<LinkageSpecDecl>(d) and d->isImplicit()) {
+                continue;
+
+                // Only handle explicit specializations here. Implicit ones are handled by the `VarTemplateDecl`
+                // itself.
+            } else if(const auto* vdspec = dyn_cast_or_null<VarTemplateSpecializationDecl>(d);
+                      vdspec and (TSK_ExplicitSpecialization != vdspec->getSpecializationKind())) {
+                continue;
+            }
+
+            insertBlankLineIfRequired(lastLoc, d->getLocation());
+
+            const auto start     = outputFormatHelper.CurrentPos();
+            gCurrentTopLevelDecl = d;
+
+#ifdef INSIGHTS_DEBUG
+            if(const auto* nd = dyn_cast_or_null<NamedDecl>(d);
+               nd and not gDebugCrashIn.empty() and (nd->getNameAsString() == gDebugCrashIn)) {
+                std::abort();
+            }
+#endif /* INSIGHTS_DEBUG */
+
+            codeGenerator->InsertArg(d);
+            gCurrentTopLevelDecl = nullptr;
+
+            if(gEmitDeclDigests) {
+                const auto generated = StringRef{outputFormatHelper.GetString()}.substr(start);
+                auto       name      = DeclDigestName(d);
+
+                // Declarations without a name, like static_asserts, still share one. Number them in source order.
+                if(const auto count = ++declDigestNames[name]; 1 < count) {
+                    name.append(StrCat(" #"sv, count));
+                }
+
+                declDigests.emplace_back(StrCat(sm.getSpellingLineNumber(d->getLocation()), " "sv, name),
+                                         llvm::hash_value(generated));
+            }
+        }
+
+        // The last declaration can be the one which reached the limit
+        if(outputFormatHelper.MaxSizeReached()) {
+            RunMustStop(true);
+        }
+
+        if(gStopReason.has_value()) {
+            // The note goes behind the output cut at the limit. The reports are incomplete, leave them out.
+            outputFormatHelper.SetMaxSize(0);
+            outputFormatHelper.SetIndent(0, OutputFormatHelper::SkipIndenting::Yes);
+            outputFormatHelper.AppendNewLine();
+            outputFormatHelper.AppendCommentNewLine("Output truncated: "sv, gStopReason.value());
+
+        } else {
+            if(GetInsightsOptions().ShowCostlyImplicitCasts) {
+                outputFormatHelper.Append(EmitCostlyImplicitCasts());
+            }
+
+            if(GetInsightsOptions().ShowNoexceptMoves) {
+                outputFormatHelper.Append(EmitNoexceptMoveAudit());
+            }
+
+            if(GetInsightsOptions().ShowStaticInit) {
+                outputFormatHelper.Append(EmitStaticInitReport());
+            }
+
+            if(GetInsightsOptions().ShowTemplateCosts) {
+                outputFormatHelper.Append(EmitTemplateCostReport());
+            }
+
+            if(GetInsightsOptions().ShowICFCandidates) {
+                outputFormatHelper.Append(EmitICFCandidates());
+            }
+
+            if(GetInsightsOptions().ShowIncludeCosts) {
+                outputFormatHelper.Append(EmitIncludeCostReport(context, mIncludeCosts));
+            }
+        }
+
+        if(gEmitDeclDigests) {
+            outputFormatHelper.Append(EmitDeclDigests(declDigests));
+        }
+
+        std::string insightsIncludes{};
+
+        if(GetInsightsOptions().ShowCoroutineTransformation) {
+            insightsIncludes.append(
+                R"(/*************************************************************************************
+ * NOTE: The coroutine transformation you've enabled is a hand coded transformation! *
+ *       Most of it is _not_ present in the AST. What you see is an approximation.   *
+ *************************************************************************************/
+)"sv);
+        } else if(GetInsightsOptions().UseShow2C or GetInsightsOptions().ShowLifetime) {
+            insightsIncludes.append(
+                R"(/*************************************************************************************
+ * NOTE: This an educational hand-rolled transformation. Things can be incorrect or  *
+ * buggy.                                                                            *
+ *************************************************************************************/
+)"sv);
+        }
+
+        // Check whether we had static local variables which we transformed. Then for the placement-new we need to
+        // include the header <new>.
+        std::string inserts{};
+        for(const auto& [active, value] : gGlobalInserts) {
+            if(not active) {
+                continue;
+            }
+
+            inserts.append(value);
+            inserts.append("\n"sv);
+        }
+
+        if(not inserts.empty()) {
+            insightsIncludes.append(inserts);
+            insightsIncludes.append("\n");
+        }
+
+        outputFormatHelper.InsertAt(0, insightsIncludes);
+
+        rewriter.InsertText(sm.getLocForStartOfFile(mainFileId), outputFormatHelper.GetString());
+
+        // Past a stop the global constructors are as incomplete as the reports
+        if(GetInsightsOptions().UseShow2C and not gStopReason.has_value()) {
+            const auto& fileEntry = sm.getFileEntryForID(mainFileId);
+            auto        cxaStart  = EmitGlobalVariableCtors();
+            const auto  cxaLoc    = sm.translateFileLineCol(fileEntry, fileEntry->getSize(), 1);
+
+            rewriter.InsertText(cxaLoc, cxaStart);
+        }
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief A precompiled preamble, of the last file -fork-server transformed, see \c -reuse-preamble, or of a source
+/// file of its command line.
+struct CachedPreamble
+{
+    std::string                                   mainFile;
+    PrecompiledPreamble                           preamble;
+    std::vector<std::pair<unsigned, std::string>> includes;  //!< What \ref FindIncludes found in the preamble, with
+                                                             //!< the offset into the main file instead of a location.
+};
+
+static std::optional<CachedPreamble> gCachedPreamble{};
+static std::vector<CachedPreamble>   gPreloadedPreambles{};
+static const CachedPreamble*         gAppliedPreamble{};
+//-----------------------------------------------------------------------------
+
+/// \brief Find a precompiled preamble which fits the main file \p mainFile with the contents \p buffer.
+///
+/// The preamble of another file fits as well, if that file is in the same directory, so that the includes resolve
+/// alike, and starts with the same include block.
+static CachedPreamble* FindPreamble(const CompilerInvocation& invocation,
+                                    StringRef                 mainFile,
+                                    const llvm::MemoryBuffer& buffer,
+                                    llvm::vfs::FileSystem&    vfs)
+{
+    const auto bounds = ComputePreambleBounds(invocation.getLangOpts(), buffer.getMemBufferRef(), 0);
+
+    auto fits = [&](const CachedPreamble& cached) {
+        return (llvm::sys::path::parent_path(cached.mainFile) == llvm::sys::path::parent_path(mainFile)) and
+               cached.preamble.CanReuse(invocation, buffer.getMemBufferRef(), bounds, vfs);
+    };
+
+    if(gCachedPreamble.has_value() and fits(gCachedPreamble.value())) {
+        return &gCachedPreamble.value();
+    }
+
+    for(auto& preloaded : gPreloadedPreambles) {
+        if(fits(preloaded)) {
+            return &preloaded;
+        }
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Run \ref FindIncludes while the preamble is built.
+///
+/// A run which uses the preamble does not lex its include directives again. It takes them from here.
+class PreambleIncludeCollector final : public PreambleCallbacks
+{
+    std::vector<IncludeData>                       mIncludes{};
+    std::vector<std::pair<unsigned, std::string>>& mResult;
+    CompilerInstance*                              mCI{};
+
+public:
+    explicit PreambleIncludeCollector(std::vector<std::pair<unsigned, std::string>>& result)
+    : PreambleCallbacks{}
+    , mResult{result}
+    {
+    }
+
+    void BeforeExecute(CompilerInstance& CI) override { mCI = &CI; }
+
+    std::unique_ptr<PPCallbacks> createPPCallbacks() override
+    {
+        return std::make_unique<FindIncludes>(mCI->getSourceManager(), mCI->getPreprocessor(), mIncludes);
+    }
+
+    void AfterExecute(CompilerInstance& CI) override
+    {
+        const auto& sm = CI.getSourceManager();
+
+        for(const auto& [loc, text] : mIncludes) {
+            mResult.emplace_back(sm.getFileOffset(loc), text);
+        }
+    }
+};
+//-----------------------------------------------------------------------------
+
+class CppInsightFrontendAction final : public ASTFrontendAction
+{
+    Rewriter                 mRewriter{};
+    std::vector<IncludeData> mIncludes{};
+    std::vector<IncludeCost> mIncludeCosts{};
+    std::vector<std::string> mOptionSetOutputs{};
+
+public:
+    CppInsightFrontendAction() = default;
+    void EndSourceFileAction() override
+    {
+        mRewriter.getEditBuffer(mRewriter.getSourceMgr().getMainFileID()).write(llvm::outs());
+
+        for(const auto& [optionSet, output] : llvm::zip(gOptionSets, mOptionSetOutputs)) {
+            llvm::outs() << "\n// -option-set: "sv << optionSet << "\n\n"sv << output;
+        }
+    }
+
+    void ExecuteAction() override
+    {
+        auto& CI = getCompilerInstance();
+
+        // Create Sema as ASTFrontendAction would, only to register the callback before the parser starts
+        if(CI.hasPreprocessor() and not CI.hasSema()) {
+            CI.createSema(getTranslationUnitKind(), nullptr);
+        }
+
+        if(CI.hasSema()) {
+            CI.getSema().TemplateInstCallbacks.push_back(std::make_unique<LimitsInstantiationCallback>());
+        }
+
+        ASTFrontendAction::ExecuteAction();
+    }
+
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& CI, StringRef /*file*/) override
+    {
+        gCI = &CI;
+
+        // The limits apply to each translation unit, one which exceeded them does not stop the following ones
+        gStopReason.reset();
+        gStartTime = std::chrono::steady_clock::now();
+
+        if(gAppliedPreamble) {
+            const auto& sm        = CI.getSourceManager();
+            const auto  fileStart = sm.getLocForStartOfFile(sm.getMainFileID());
+
+            for(const auto& [offset, text] : gAppliedPreamble->includes) {
+                mIncludes.emplace_back(fileStart.getLocWithOffset(offset), text);
+            }
+        }
+
+        Preprocessor& pp = CI.getPreprocessor();
+
+        // A serialized AST is not parsed again, its includes come from the stored preprocessing record
+        if(isCurrentFileAST()) {
+            FindIncludesInPreprocessingRecord(CI.getSourceManager(), pp, mIncludes);
+        } else {
+            pp.addPPCallbacks(std::make_unique<FindIncludes>(CI.getSourceManager(), pp, mIncludes));
+        }
+
+        // Only the preprocessor sees the includes, collect them if any pass reports them
+        if(AnyOptionSetEnables(&InsightsOptions::ShowIncludeCosts)) {
+            pp.addPPCallbacks(std::make_unique<IncludeCosts>(CI.getSourceManager(), mIncludeCosts));
+        }
+
+        mRewriter.setSourceMgr(CI.getSourceManager(), CI.getLangOpts());
+        return std::make_unique<CppInsightASTConsumer>(mRewriter, mIncludes, mIncludeCosts, mOptionSetOutputs);
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Precompile the preamble of the main file, unless a cached one already fits, see \ref FindPreamble.
+class PreambleBuilderAction final : public ToolAction
+{
+public:
+    enum Kind
+    {
+        Cache,    //!< Replace the preamble of the last request, see \c -reuse-preamble.
+        Preload,  //!< Keep the preamble for the lifetime of the -fork-server.
+    };
+
+    explicit PreambleBuilderAction(Kind kind)
+    : mKind{kind}
+    {
+    }
+
+    bool runInvocation(std::shared_ptr<CompilerInvocation>   invocation,
+                       FileManager*                          files,
+                       std::shared_ptr<PCHContainerOperations> pchContainerOps,
+                       DiagnosticConsumer* /*DiagConsumer*/) override
+    {
+        const auto& input = invocation->getFrontendOpts().Inputs[0];
+
+        // A serialized AST has no preamble to precompile
+        if(InputKind::Precompiled == input.getKind().getFormat()) {
+            return true;
+        }
+
+        const auto mainFile = input.getFile();
+        auto       vfs      = files->getVirtualFileSystemPtr();
+        auto       buffer   = vfs->getBufferForFile(mainFile);
+
+        if(not buffer) {
+            return false;
+        }
+
+        if(FindPreamble(*invocation, mainFile, **buffer, *vfs)) {
+            return true;
+        }
+
+        if(Cache == mKind) {
+            gCachedPreamble.reset();
+        }
+
+        const auto bounds = ComputePreambleBounds(invocation->getLangOpts(), (*buffer)->getMemBufferRef(), 0);
+
+        if(0 == bounds.Size) {
+            return true;
+        }
+
+        // The transformation reports the diagnostics, don't show them twice
+        auto diags = CompilerInstance::createDiagnostics(&invocation->getDiagnosticOpts(), new IgnoringDiagConsumer{});
+
+        std::vector<std::pair<unsigned, std::string>> includes{};
+        PreambleIncludeCollector                      callbacks{includes};
+
+        // Store the preamble in a temporary file, that way the forked children can use it without changes to the VFS
+        auto preamble = PrecompiledPreamble::Build(
+            *invocation, buffer->get(), bounds, *diags, vfs, std::move(pchContainerOps), false, {}, callbacks);
+
+        if(not preamble) {
+            return false;
+        }
+
+        CachedPreamble cached{mainFile.str(), std::move(*preamble), std::move(includes)};
+
+        if(Preload == mKind) {
+            gPreloadedPreambles.push_back(std::move(cached));
+        } else {
+            gCachedPreamble.emplace(std::move(cached));
+        }
+
+        return true;
+    }
+
+private:
+    Kind mKind;
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Report a crash in the format of a diagnostic, located at the top-level declaration which was transformed.
+static void ReportCrash(const CompilerInstance& compiler)
+{
+    auto& errs = llvm::errs();
+
+    if(nullptr == gCurrentTopLevelDecl) {
+        errs << compiler.getFrontendOpts().Inputs[0].getFile()
+             << ": error: C++ Insights crashed outside of the transformation of a top-level declaration\n"sv;
+        return;
+    }
+
+    const auto& sm = compiler.getSourceManager();
+    sm.getExpansionLoc(gCurrentTopLevelDecl->getLocation()).print(errs, sm);
+
+    errs << ": error: C++ Insights crashed while transforming this "sv << gCurrentTopLevelDecl->getDeclKindName()
+         << " declaration"sv;
+
+    if(const auto* nd = dyn_cast_or_null<NamedDecl>(gCurrentTopLevelDecl)) {
+        errs << " '"sv << nd->getQualifiedNameAsString() << "'"sv;
+    }
+
+    errs << '\n';
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Run the transformation like \c newFrontendActionFactory does, with the cached preamble if it still fits.
+///
+/// The transformation runs in a crash recovery context. A crash only fails the translation unit at hand, the others
+/// of a batch still get transformed.
+class InsightsToolAction final : public ToolAction
+{
+public:
+    bool runInvocation(std::shared_ptr<CompilerInvocation>   invocation,
+                       FileManager*                          files,
+                       std::shared_ptr<PCHContainerOperations> pchContainerOps,
+                       DiagnosticConsumer*                   diagConsumer) override
+    {
+        gAppliedPreamble = nullptr;
+
+        if(const auto mainFile = invocation->getFrontendOpts().Inputs[0].getFile();
+           gCachedPreamble.has_value() or not gPreloadedPreambles.empty()) {
+            auto vfs = files->getVirtualFileSystemPtr();
+
+            if(auto buffer = vfs->getBufferForFile(mainFile)) {
+                if(auto* preamble = FindPreamble(*invocation, mainFile, **buffer, *vfs)) {
+                    preamble->preamble.AddImplicitPreamble(*invocation, vfs, buffer->get());
+                    gAppliedPreamble = preamble;
+                }
+            }
+        }
+
+        auto compiler = std::make_unique<CompilerInstance>(std::move(pchContainerOps));
+        compiler->setInvocation(std::move(invocation));
+        compiler->setFileManager(files);
+        compiler->createDiagnostics(diagConsumer, false);
+
+        if(not compiler->hasDiagnostics()) {
+            return false;
+        }
+
+        compiler->createSourceManager(*files);
+
+        auto                       action = std::make_unique<CppInsightFrontendAction>();
+        bool                       success{};
+        llvm::CrashRecoveryContext crashRecovery{};
+
+        gCurrentTopLevelDecl = nullptr;
+
+        if(not crashRecovery.RunSafely([&] { success = compiler->ExecuteAction(*action); })) {
+            ReportCrash(*compiler);
+            gCrashed = true;
+
+            // Leave nothing of the crashed run to the next translation unit. The state of the compiler and the action
+            // is unknown, don't run their destructors.
+            ResetGeneratorState();
+            gCurrentTopLevelDecl = nullptr;
+            (void)compiler.release();
+            (void)action.release();
+        }
+
+        files->clearStatCache();
+
+        return success;
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Serve the include directories of a header archive from memory, everything else from the real file system.
+///
+/// A path below one of the packed directories never reaches the real file system, not even if the file does not
+/// exist. That way, the header search probing each include directory costs no system call. The archive is mapped
+/// into memory once and the files refer to it without a copy.
+class HeaderArchiveFileSystem final : public llvm::vfs::ProxyFileSystem
+{
+    std::unique_ptr<llvm::MemoryBuffer>               mArchive;
+    IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> mHeaders{new llvm::vfs::InMemoryFileSystem{}};
+    SmallVector<StringRef, 4>                         mRoots{};
+
+    bool IsPacked(const Twine& path) const
+    {
+        // The driver adds some include directories with a "..", the packed ones are normalized
+        SmallString<256> normalized{};
+        path.toVector(normalized);
+        llvm::sys::path::remove_dots(normalized, true);
+
+        return llvm::any_of(mRoots, [path = normalized.str()](StringRef root) {
+            return path.starts_with(root) and
+                   ((path.size() == root.size()) or llvm::sys::path::is_separator(path[root.size()]));
+        });
+    }
+
+public:
+    explicit HeaderArchiveFileSystem(std::unique_ptr<llvm::MemoryBuffer> archive)
+    : ProxyFileSystem{llvm::vfs::getRealFileSystem()}
+    , mArchive{std::move(archive)}
+    {
+    }
+
+    /// \brief Map the archive at \p path into memory.
+    ///
+    /// \returns The file system or null, if the archive cannot be read or is malformed.
+    static IntrusiveRefCntPtr<HeaderArchiveFileSystem> Create(StringRef path)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+
+        if(not buffer) {
+            return nullptr;
+        }
+
+        IntrusiveRefCntPtr<HeaderArchiveFileSystem> fs{new HeaderArchiveFileSystem{std::move(*buffer)}};
+
+        // See scripts/pack-headers.py for the format
+        StringRef data = fs->mArchive->getBuffer();
+        auto      nextLine = [&] {
+            auto [line, rest] = data.split('\n');
+            data              = rest;
+            return line;
+        };
+
+        if(nextLine() != "insights-header-archive 1"sv) {
+            return nullptr;
+        }
+
+        while(not data.empty()) {
+            auto line = nextLine();
+
+            if(line.consume_front("root "sv)) {
+                fs->mRoots.push_back(line);
+
+            } else if(size_t size{}; line.consume_front("file "sv) and not line.consumeInteger(10, size) and
+                                     line.consume_front(" "sv) and (size < data.size()) and ('\0' == data[size])) {
+                // The NUL after each file makes it usable as a null terminated buffer for the lexer
+                fs->mHeaders->addFileNoOwn(line, 0, llvm::MemoryBufferRef{data.take_front(size), line});
+                data = data.drop_front(size + 1);
+
+            } else {
+                return nullptr;
+            }
+        }
+
+        return fs;
+    }
+
+    llvm::ErrorOr<llvm::vfs::Status> status(const Twine& path) override
+    {
+        return IsPacked(path) ? mHeaders->status(path) : ProxyFileSystem::status(path);
+    }
+
+    llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const Twine& path) override
+    {
+        return IsPacked(path) ? mHeaders->openFileForRead(path) : ProxyFileSystem::openFileForRead(path);
+    }
+
+    llvm::vfs::directory_iterator dir_begin(const Twine& dir, std::error_code& ec) override
+    {
+        return IsPacked(dir) ? mHeaders->dir_begin(dir, ec) : ProxyFileSystem::dir_begin(dir, ec);
+    }
+};
+//-----------------------------------------------------------------------------
+
+#ifndef _WIN32
+/// \brief Run \p run in a forked child, which writes its output into a pipe.
+///
+/// \returns The process id of the child or -1, if it could not be started. \p readFd receives the read end of the
+/// pipe. With \p errorFd, the errors of the child go into a second pipe, of which it receives the read end.
+static pid_t ForkWithPipedOutput(llvm::function_ref<int()> run, int& readFd, int* errorFd = nullptr)
+{
+    std::array<int, 2> fds{};
+    std::array<int, 2> errorFds{-1, -1};
+
+    if(0 != pipe(fds.data())) {
+        return -1;
+
+    } else if(errorFd and (0 != pipe(errorFds.data()))) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    auto closePipes = [&] {
+        for(const int fd : {fds[0], fds[1], errorFds[0], errorFds[1]}) {
+            if(-1 != fd) {
+                close(fd);
+            }
+        }
+    };
+
+    // Nothing buffered may end up in the output of both processes
+    llvm::outs().flush();
+
+    const pid_t pid = fork();
+
+    if(-1 == pid) {
+        closePipes();
+        return -1;
+
+    } else if(0 == pid) {
+        dup2(fds[1], STDOUT_FILENO);
+
+        if(errorFd) {
+            dup2(errorFds[1], STDERR_FILENO);
+        }
+
+        closePipes();
+
+        const auto status = run();
+
+        llvm::outs().flush();
+        // Skip the exit handlers and static destructors, they belong to the parent
+        _exit(status);
+    }
+
+    close(fds[1]);
+    readFd = fds[0];
+
+    if(errorFd) {
+        close(errorFds[1]);
+        *errorFd = errorFds[0];
+    }
+
+    return pid;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Append what a child \ref ForkWithPipedOutput started wrote into its pipe to \p output.
+///
+/// \returns False, once the child closed its end of the pipe. \p readFd is closed then.
+static bool ReadChildOutput(int readFd, std::string& output)
+{
+    std::array<char, 64 * 1024> buffer{};
+
+    for(;;) {
+        const ssize_t bytesRead = read(readFd, buffer.data(), buffer.size());
+
+        if(0 < bytesRead) {
+            output.append(buffer.data(), static_cast<size_t>(bytesRead));
+            return true;
+
+        } else if((0 > bytesRead) and (EINTR == errno)) {
+            continue;
+        }
+
+        close(readFd);
+        return false;
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Wait for a child \ref ForkWithPipedOutput started to exit.
+///
+/// \returns The exit status of the child. A crash is reported like a shell does, with 128 plus the signal number.
+static int WaitForChild(pid_t pid)
+{
+    int waitStatus{};
+    while((-1 == waitpid(pid, &waitStatus, 0)) and (EINTR == errno)) {
+    }
+
+    return WIFEXITED(waitStatus) ? WEXITSTATUS(waitStatus) : (128 + WTERMSIG(waitStatus));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The status of the -fork-server response to a request which found the queue full, see
+/// \c -fork-server-max-queue.
+static constexpr int gRejectedStatus{6};
+//-----------------------------------------------------------------------------
+
+/// \brief Serve one transformation per request read from a line of <stdin>, each in a forked child.
+///
+/// The parent parses the options, sets up the arguments and precompiles the preambles of the source files of the
+/// command line only once, see \ref FindPreamble. Each child starts from a copy-on-write snapshot of it, so a crash or
+/// a failed assertion only takes down the request at hand. The child writes its output and its errors into two
+/// pipes. The parent answers each request with a line containing the exit status, the size of the output, the size
+/// of the errors and the number of the request, counting from 1, followed by the output and the errors. With more
+/// than one job the answers come in the order the requests finish.
+///
+/// A request is a source file path or a client name, a priority and the path, separated by tabs. Each client has a
+/// queue of its own. The next request to run is the one with the highest priority at the front of all queues, on a
+/// tie the one which waits longest. A newer request of a client for the same file supersedes the older one. A
+/// waiting one is answered with \ref gCancelledExitCode right away. A running child receives a SIGTERM, it stops
+/// like with \c -cancel-on-signal, during parsing or between two top-level declarations. A request which finds
+/// \c -fork-server-max-queue requests waiting is answered with \ref gRejectedStatus.
+///
+/// At the end of the input, the server writes the number of requests, the cancellations, the rejections and the
+/// time the requests waited in the queue to <stderr>.
+class ForkServer final
+{
+public:
+    using RunTool     = llvm::function_ref<int(ArrayRef<std::string>, ToolAction&)>;
+    using RunInsights = llvm::function_ref<int(ArrayRef<std::string>)>;
+
+    ForkServer(RunTool runTool, RunInsights runInsights)
+    : mRunTool{runTool}
+    , mRunInsights{runInsights}
+    {
+    }
+
+    int Run()
+    {
+        const size_t jobs = std::max(1u, gForkServerJobs.getValue());
+        std::string  input{};  // What was read from <stdin> behind the last complete line
+        bool         inputOpen{true};
+
+        while(inputOpen or (0 != mQueued) or not mChildren.empty()) {
+            while((mChildren.size() < jobs) and StartNext()) {
+            }
+
+            std::vector<pollfd> fds{};
+
+            if(inputOpen) {
+                fds.push_back({STDIN_FILENO, POLLIN, 0});
+            }
+
+            const size_t firstChild = fds.size();
+
+            // poll ignores a pipe the child already closed, its descriptor is -1
+            for(const auto& child : mChildren) {
+                fds.push_back({child.readFd, POLLIN, 0});
+                fds.push_back({child.errorFd, POLLIN, 0});
+            }
+
+            if(-1 == poll(fds.data(), fds.size(), -1)) {
+                if(EINTR == errno) {
+                    continue;
+                }
+
+                llvm::errs() << "fork-server: waiting for input failed\n"sv;
+                return 1;
+            }
+
+            for(size_t i{}; i < mChildren.size(); ++i) {
+                auto&       child      = mChildren[i];
+                const auto& outputPoll = fds[firstChild + (2 * i)];
+                const auto& errorPoll  = fds[firstChild + (2 * i) + 1];
+
+                if((0 != outputPoll.revents) and not ReadChildOutput(child.readFd, child.output)) {
+                    child.readFd = -1;
+                }
+
+                if((0 != errorPoll.revents) and not ReadChildOutput(child.errorFd, child.errors)) {
+                    child.errorFd = -1;
+                }
+
+                if((-1 == child.readFd) and (-1 == child.errorFd)) {
+                    Finish(child);
+                }
+            }
+
+            llvm::erase_if(mChildren, [](const Child& child) { return -1 == child.pid; });
+
+            // Finished children are gone, a request which supersedes one of them must not signal it
+            if(inputOpen and (0 != fds.front().revents)) {
+                std::array<char, 4 * 1024> buffer{};
+                const ssize_t              bytesRead = read(STDIN_FILENO, buffer.data(), buffer.size());
+
+                if(0 < bytesRead) {
+                    input.append(buffer.data(), static_cast<size_t>(bytesRead));
+
+                } else if((0 == bytesRead) or (EINTR != errno)) {
+                    inputOpen = false;
+
+                    // Like std::getline, take an unterminated last line as a request
+                    input.push_back('\n');
+                }
+
+                for(size_t lineEnd{}; std::string::npos != (lineEnd = input.find('\n'));) {
+                    Receive(StringRef{input}.take_front(lineEnd));
+                    input.erase(0, lineEnd + 1);
+                }
+            }
+        }
+
+        llvm::errs() << "fork-server: "sv << mReceived << " requests, "sv << mStarted << " started, "sv << mSuperseded
+                     << " superseded, "sv << mRejected << " rejected, queue wait average "sv
+                     << ((0 != mStarted) ? (mTotalWait.count() / mStarted) : 0) << " ms, maximum "sv
+                     << mMaxWait.count() << " ms\n"sv;
+
+        return 0;
+    }
+
+private:
+    struct Request
+    {
+        unsigned                              number{};
+        std::string                           client{};
+        int                                   priority{};
+        std::string                           sourcePath{};
+        std::chrono::steady_clock::time_point received{};
+    };
+
+    struct Child
+    {
+        Request     request{};
+        pid_t       pid{-1};
+        int         readFd{-1};
+        int         errorFd{-1};
+        std::string output{};
+        std::string errors{};
+        bool        superseded{};
+    };
+
+    RunTool                               mRunTool;
+    RunInsights                           mRunInsights;
+    llvm::StringMap<std::deque<Request>> mQueues{};
+    std::vector<Child>                    mChildren{};
+    size_t                                mQueued{};
+    unsigned                              mReceived{};
+    unsigned                              mStarted{};
+    unsigned                              mSuperseded{};
+    unsigned                              mRejected{};
+    std::chrono::milliseconds             mTotalWait{};
+    std::chrono::milliseconds             mMaxWait{};
+
+    static void Respond(unsigned number, int status, StringRef output = {}, StringRef errors = {})
+    {
+        llvm::outs() << status << ' ' << output.size() << ' ' << errors.size() << ' ' << number << '\n'
+                     << output << errors;
+        llvm::outs().flush();
+    }
+
+    void Receive(StringRef line)
+    {
+        RETURN_IF(line.empty());
+
+        Request request{++mReceived, {}, 0, line.str(), std::chrono::steady_clock::now()};
+
+        if(line.contains('\t')) {
+            SmallVector<StringRef, 3> fields{};
+            line.split(fields, '\t', 2);
+
+            if((3 != fields.size()) or fields[0].empty() or fields[1].getAsInteger(10, request.priority)) {
+                llvm::errs() << "fork-server: malformed request '"sv << line << "'\n"sv;
+                Respond(request.number, 1);
+                return;
+            }
+
+            request.client     = fields[0].str();
+            request.sourcePath = fields[2].str();
+
+            // Cancel first, the newer request may take the place of the older one in the queue
+            Supersede(request);
+        }
+
+        if((0 != gForkServerMaxQueue) and (mQueued >= gForkServerMaxQueue)) {
+            ++mRejected;
+            Respond(request.number, gRejectedStatus);
+            return;
+        }
+
+        // Behind all waiting requests of the same or a higher priority
+        auto&      queue = mQueues[request.client];
+        const auto pos   = llvm::find_if(queue, [&](const Request& r) { return r.priority < request.priority; });
+
+        queue.insert(pos, std::move(request));
+        ++mQueued;
+    }
+
+    void Supersede(const Request& request)
+    {
+        auto sameFile = [&](const Request& r) { return r.sourcePath == request.sourcePath; };
+        auto& queue    = mQueues[request.client];
+
+        for(auto it = queue.begin(); it != queue.end();) {
+            if(sameFile(*it)) {
+                ++mSuperseded;
+                --mQueued;
+                Respond(it->number, gCancelledExitCode);
+                it = queue.erase(it);
+
+            } else {
+                ++it;
+            }
+        }
+
+        for(auto& child : mChildren) {
+            if(not child.superseded and (child.request.client == request.client) and sameFile(child.request)) {
+                ++mSuperseded;
+                child.superseded = true;
+                kill(child.pid, SIGTERM);
+            }
+        }
+    }
+
+    /// \brief Fork a child for the waiting request which runs next.
+    ///
+    /// \returns False, if no request waits.
+    bool StartNext()
+    {
+        std::deque<Request>* next{};
+
+        for(auto& entry : mQueues) {
+            auto& queue = entry.getValue();
+
+            if(queue.empty()) {
+                continue;
+            }
+
+            const auto& candidate = queue.front();
+
+            if((nullptr == next) or (candidate.priority > next->front().priority) or
+               ((candidate.priority == next->front().priority) and (candidate.number < next->front().number))) {
+                next = &queue;
+            }
+        }
+
+        if(nullptr == next) {
+            return false;
+        }
+
+        Child child{std::move(next->front())};
+        next->pop_front();
+        --mQueued;
+
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                                child.request.received);
+        ++mStarted;
+        mTotalWait += wait;
+        mMaxWait = std::max(mMaxWait, wait);
+
+        // Build the preamble in the parent so that all children of the same file share it. Should the build fail,
+        // the child parses the whole file.
+        if(gReusePreamble) {
+            PreambleBuilderAction preambleBuilder{PreambleBuilderAction::Cache};
+            mRunTool(child.request.sourcePath, preambleBuilder);
+        }
+
+        child.pid = ForkWithPipedOutput(
+            [&] {
+                // A newer request of the same client stops this one cleanly
+                llvm::sys::SetInterruptFunction([] { gCancelled = true; });
+
+                return mRunInsights(child.request.sourcePath);
+            },
+            child.readFd,
+            &child.errorFd);
+
+        if(-1 == child.pid) {
+            llvm::errs() << "fork-server: starting the child failed\n"sv;
+            Respond(child.request.number, 1);
+
+        } else {
+            mChildren.push_back(std::move(child));
+        }
+
+        return true;
+    }
+
+    void Finish(Child& child)
+    {
+        auto status = WaitForChild(child.pid);
+
+        // The SIGTERM arrived before the child was ready to stop cleanly
+        if(child.superseded and ((128 + SIGTERM) == status)) {
+            status = gCancelledExitCode;
+        }
+
+        Respond(child.request.number, status, child.output, child.errors);
+        child.pid = -1;
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The digest of the code a top-level declaration transforms into, see \ref EmitDeclDigests.
+struct DeclDigest
+{
+    unsigned    line{};
+    std::string digest{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Split the declaration digests off the end of \p output, by the name \ref DeclDigestName gave them.
+static llvm::StringMap<DeclDigest> TakeDeclDigests(std::string& output)
+{
+    llvm::StringMap<DeclDigest> digests{};
+
+    const auto start = output.rfind(gDeclDigestsTitle);
+    if(std::string::npos == start) {
+        return digests;
+    }
+
+    // The cfront transformation appends its global constructors behind the digests
+    size_t end = start + gDeclDigestsTitle.size();
+    while(StringRef{output}.substr(end).starts_with("/* "sv)) {
+        const auto lineEnd = output.find('\n', end);
+
+        if(std::string::npos == lineEnd) {
+            break;
+        }
+
+        // A line reads "/* <digest> <line> <declaration> */"
+        const auto line                 = StringRef{output}.slice(end + 3, lineEnd).drop_back(3);
+        const auto [digest, rest]       = line.split(' ');
+        const auto [declLine, declName] = rest.split(' ');
+        auto&      declDigest           = digests[declName];
+
+        declLine.getAsInteger(10, declDigest.line);
+        declDigest.digest = digest.str();
+
+        end = lineEnd + 1;
+    }
+
+    output.erase(start, end - start);
+
+    return digests;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Transform the source once for each variant of \c -std-fan-out, each in a forked child.
+///
+/// All children run at the same time. They share the parsed options and, copy-on-write, the memory of the parent.
+/// The outputs follow each other, behind them a summary lists the top-level declarations which transform
+/// differently.
+static int RunStdFanOut(llvm::function_ref<int()> runInsights, std::vector<std::string>& variantArgs)
+{
+    struct Variant
+    {
+        std::string                 name;
+        pid_t                       pid{-1};
+        int                         readFd{-1};
+        int                         status{1};
+        std::string                 output{};
+        llvm::StringMap<DeclDigest> digests{};
+    };
+
+    SmallVector<Variant, 4> variants{};
+
+    gEmitDeclDigests = true;
+
+    for(const auto& variant : gStdFanOut) {
+        // A variant is either a standard or a list of arguments
+        variantArgs.clear();
+
+        if(StringRef{variant}.starts_with("-"sv)) {
+            SmallVector<StringRef, 4> args{};
+            StringRef{variant}.split(args, ' ', -1, false);
+
+            for(const auto& arg : args) {
+                variantArgs.push_back(arg.str());
+            }
+
+        } else {
+            variantArgs.push_back(StrCat("-std="sv, variant));
+        }
+
+        auto& current = variants.emplace_back(Variant{variant});
+        current.pid   = ForkWithPipedOutput(runInsights, current.readFd);
+
+        if(-1 == current.pid) {
+            llvm::errs() << "std-fan-out: starting the child for '"sv << variant << "' failed\n"sv;
+        }
+    }
+
+    // Read all pipes as the output arrives, a child with a full pipe would wait for its turn otherwise
+    for(;;) {
+        std::vector<pollfd> fds{};
+
+        // poll ignores a pipe which is already closed, its descriptor is -1
+        for(const auto& variant : variants) {
+            fds.push_back({variant.readFd, POLLIN, 0});
+        }
+
+        if(llvm::all_of(fds, [](const pollfd& fd) { return -1 == fd.fd; })) {
+            break;
+
+        } else if(-1 == poll(fds.data(), fds.size(), -1)) {
+            if(EINTR == errno) {
+                continue;
+            }
+
+            llvm::errs() << "std-fan-out: waiting for the output failed\n"sv;
+
+            // A child which still writes gets a SIGPIPE and does not block the wait below
+            for(auto& variant : variants) {
+                if(-1 != variant.readFd) {
+                    close(variant.readFd);
+                    variant.readFd = -1;
+                }
+            }
+
+            break;
+        }
+
+        for(auto&& [variant, fd] : llvm::zip(variants, fds)) {
+            if((0 != fd.revents) and not ReadChildOutput(variant.readFd, variant.output)) {
+                variant.readFd = -1;
+            }
+        }
+    }
+
+    int status{};
+
+    for(auto& variant : variants) {
+        if(-1 == variant.pid) {
+            continue;
+        }
+
+        variant.status  = WaitForChild(variant.pid);
+        variant.digests = TakeDeclDigests(variant.output);
+    }
+
+    for(const auto& variant : variants) {
+        llvm::outs() << "// -std-fan-out: "sv << variant.name;
+
+        if(0 != variant.status) {
+            llvm::outs() << " (exit status "sv << variant.status << ")"sv;
+
+            if(0 == status) {
+                status = variant.status;
+            }
+        }
+
+        llvm::outs() << "\n\n"sv << variant.output << "\n"sv;
+    }
+
+    // Every declaration any of the variants has, in the order of the source
+    SmallVector<std::pair<unsigned, StringRef>, 16> decls{};
+    for(const auto& variant : variants) {
+        for(const auto& digest : variant.digests) {
+            if(llvm::none_of(decls, [&](const auto& decl) { return decl.second == digest.getKey(); })) {
+                decls.emplace_back(digest.getValue().line, digest.getKey());
+            }
+        }
+    }
+
+    llvm::sort(decls);
+
+    OutputFormatHelper ofm{};
+    ofm.AppendCommentNewLine("Declarations which transform differently:"sv);
+
+    for(const auto& [line, decl] : decls) {
+        // Group the variants which produce the same code for this declaration
+        SmallVector<std::pair<std::string, std::string>, 4> groups{};
+
+        for(const auto& variant : variants) {
+            const auto digest = variant.digests.lookup(decl).digest;
+            auto       group  = llvm::find_if(groups, [&](const auto& g) { return g.first == digest; });
+
+            if(group == groups.end()) {
+                groups.emplace_back(digest, variant.name);
+
+            } else {
+                group->second.append(StrCat(", "sv, variant.name));
+            }
+        }
+
+        if(1 == groups.size()) {
+            continue;
+        }
+
+        std::string description{};
+        for(const auto& [digest, names] : groups) {
+            description.append(
+                StrCat(description.empty() ? ""sv : " | "sv, names, digest.empty() ? " (missing)"sv : ""sv));
+        }
+
+        ofm.AppendCommentNewLine("line "sv, line, " "sv, decl, ": "sv, description);
+    }
+
+    llvm::outs() << ofm.GetString();
+
+    return status;
+}
+//-----------------------------------------------------------------------------
+#endif /* _WIN32 */
+
+#include "clang/Basic/Version.h"
 
 static void PrintVersion(raw_ostream& ostream)
 {
@@ -339,6 +2119,23 @@ static void PrintVersion(raw_ostream& ostream)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief The archive given by \c -header-archive, or else the one the build placed next to the binary.
+static std::string GetHeaderArchivePath(const char* argv0)
+{
+#ifdef INSIGHTS_HEADER_ARCHIVE_NAME
+    if(not gHeaderArchive.getNumOccurrences()) {
+        SmallString<256> path{llvm::sys::fs::getMainExecutable(argv0, reinterpret_cast<void*>(&GetHeaderArchivePath))};
+        llvm::sys::path::remove_filename(path);
+        llvm::sys::path::append(path, INSIGHTS_HEADER_ARCHIVE_NAME);
+
+        return std::string{path};
+    }
+#endif /* INSIGHTS_HEADER_ARCHIVE_NAME */
+
+    return gHeaderArchive;
+}
+//-----------------------------------------------------------------------------
+
 int main(int argc, const char** argv)
 {
     // Headers go first
@@ -394,18 +2191,39 @@ extern struct __mptr* __vtbl_array[];
         return 1;
     }
 
+    if(gCancelOnSignal) {
+        // Only the first signal stops the run cleanly, LLVM removes the interrupt function once it is called.
+        llvm::sys::SetInterruptFunction([] { gCancelled = true; });
+    }
+
+    // Let a crash fail only the translation unit in which it happens, see InsightsToolAction
+    llvm::CrashRecoveryContext::Enable();
+
+    // Reject an unknown option in one of the sets before the source gets parsed
+    for(const auto options = GetInsightsOptions(); const auto& optionSet : gOptionSets) {
+        if(const auto unknown = ApplyOptionSet(optionSet)) {
+            llvm::errs() << "Unknown option '"sv << unknown.value() << "' in -option-set.\n"sv;
+            return 1;
+        }
+
+        gInsightsOptions = options;
+    }
+
     // In STDINMode, we override the file content with the <stdin> input.
     // Since `tool.mapVirtualFile` takes `StringRef`, we define `Code` outside of
     // the if-block so that `Code` is not released after the if-block.
     std::unique_ptr<llvm::MemoryBuffer> inMemoryCode{};
 
     CommonOptionsParser& op{opExpected.get()};
-    ClangTool            tool(op.getCompilations(), op.getSourcePathList());
 
     if(gStdinMode) {
         if(op.getSourcePathList().size() != 1) {
             llvm::errs() << "Expect exactly one file path in STDINMode.\n"sv;
             return 1;
+
+        } else if(gForkServerMode) {
+            llvm::errs() << "STDINMode cannot be combined with -fork-server.\n"sv;
+            return 1;
         }
 
         llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> codeOrErr = llvm::MemoryBuffer::getSTDIN();
@@ -421,40 +2239,127 @@ extern struct __mptr* __vtbl_array[];
             Error("empty file\n");
             return 1;  // Skip empty files.
         }
-
-        llvm::StringRef sourceFilePath = op.getSourcePathList().front();
-        tool.mapVirtualFile(sourceFilePath, inMemoryCode->getBuffer());
     }
 
-    auto prependArgument = [&](auto arg) {
-        tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(arg, ArgumentInsertPosition::BEGIN));
-    };
+    if(not gStdFanOut.empty() and (gForkServerMode or not gOptionSets.empty())) {
+        llvm::errs() << "-std-fan-out cannot be combined with -fork-server or -option-set.\n"sv;
+        return 1;
+
+    } else if(not gSharedOutputPath.empty() and (not gStdFanOut.empty() or not gOptionSets.empty())) {
+        // The variants would store different code under the same key
+        llvm::errs() << "-shared-output cannot be combined with -std-fan-out or -option-set.\n"sv;
+        return 1;
 
-    // Special handling to spare users to figure out what include paths to add.
+    } else if(const auto& options = GetInsightsOptions();
+              not gSharedOutputPath.empty() and
+              (options.UseShow2C or options.ShowCostlyImplicitCasts or options.ShowNoexceptMoves or
+               options.ShowStaticInit or options.ShowTemplateCosts or options.ShowICFCandidates)) {
+        // These collect what the generated declarations contain. A declaration another run stored would be missing.
+        llvm::errs() << "-shared-output cannot be combined with -edu-show-cfront or a report of the whole translation "
+                        "unit.\n"sv;
+        return 1;
+    }
 
     // For some reason, Clang on Apple seems to require an additional hint for the C++ headers.
 #ifdef __APPLE__
     gUseLibCpp = true;
 #endif /* __APPLE__ */
 
-    if(gUseLibCpp) {
-        prependArgument(INSIGHTS_LLVM_INCLUDE_DIR);
-        prependArgument("-stdlib=libc++");
-        prependArgument("-fexperimental-library");
+    IntrusiveRefCntPtr<llvm::vfs::FileSystem> baseFileSystem = llvm::vfs::getRealFileSystem();
 
-#ifdef __APPLE__
-        prependArgument("-nostdinc++");  // macos Monterey
-#endif                                   /* __APPLE__ */
+    if(const std::string headerArchivePath = GetHeaderArchivePath(argv[0]); not headerArchivePath.empty()) {
+        if(auto headerArchive = HeaderArchiveFileSystem::Create(headerArchivePath)) {
+            baseFileSystem = std::move(headerArchive);
+
+            // Only an explicitly requested archive must exist, a binary copied without its archive uses the file system
+        } else if(gHeaderArchive.getNumOccurrences()) {
+            llvm::errs() << "Cannot read the -header-archive file '"sv << gHeaderArchive << "'.\n"sv;
+            return 1;
+        }
     }
 
-    prependArgument(INSIGHTS_CLANG_RESOURCE_INCLUDE_DIR);
-    prependArgument(INSIGHTS_CLANG_RESOURCE_DIR);
+    // The arguments of the current -std-fan-out variant
+    std::vector<std::string> variantArgs{};
 
-    if(GetInsightsOptions().UseShow2C) {
-        EnableGlobalInsert(FuncCxaStart);
-        EnableGlobalInsert(FuncCxaAtExit);
+    auto runTool = [&](ArrayRef<std::string> sourcePaths, ToolAction& action) {
+        ClangTool tool(op.getCompilations(), sourcePaths, std::make_shared<PCHContainerOperations>(), baseFileSystem);
+
+        if(inMemoryCode) {
+            tool.mapVirtualFile(sourcePaths.front(), inMemoryCode->getBuffer());
+        }
+
+        auto prependArgument = [&](auto arg) {
+            tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(arg, ArgumentInsertPosition::BEGIN));
+        };
+
+        // Special handling to spare users to figure out what include paths to add.
+        if(gUseLibCpp) {
+            prependArgument(INSIGHTS_LLVM_INCLUDE_DIR);
+            prependArgument("-stdlib=libc++");
+            prependArgument("-fexperimental-library");
+
+#ifdef __APPLE__
+            prependArgument("-nostdinc++");  // macos Monterey
+#endif                                       /* __APPLE__ */
+        }
+
+        prependArgument(INSIGHTS_CLANG_RESOURCE_INCLUDE_DIR);
+        prependArgument(INSIGHTS_CLANG_RESOURCE_DIR);
+
+        if(not variantArgs.empty()) {
+            tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(variantArgs, ArgumentInsertPosition::END));
+        }
+
+        return tool.run(&action);
+    };
+
+    auto runInsights = [&](ArrayRef<std::string> sourcePaths) {
+        // Read the file again for each run, a -fork-server child sees what its predecessors added
+        if(not gSharedOutputPath.empty() and not OpenSharedOutput(gSharedOutputPath)) {
+            llvm::errs() << "Cannot open the -shared-output file '"sv << gSharedOutputPath << "'.\n"sv;
+            return 1;
+        }
+
+        InsightsToolAction action{};
+        const auto         status = runTool(sourcePaths, action);
+
+        if(gCancelled) {
+            return gCancelledExitCode;
+
+        } else if(gStoppedEarly) {
+            return gResourceLimitExitCode;
+
+        } else if(gCrashed) {
+            return gCrashedExitCode;
+        }
+
+        return status;
+    };
+
+    if(gForkServerMode) {
+#ifdef _WIN32
+        llvm::errs() << "-fork-server is not supported on Windows.\n"sv;
+        return 1;
+#else
+        // Load the headers the requests likely need before forking, all children share them
+        for(const auto& sourcePath : op.getSourcePathList()) {
+            PreambleBuilderAction preloader{PreambleBuilderAction::Preload};
+            runTool(sourcePath, preloader);
+        }
+
+        return ForkServer{runTool, runInsights}.Run();
+#endif /* _WIN32 */
+    }
+
+    if(not gStdFanOut.empty()) {
+#ifdef _WIN32
+        llvm::errs() << "-std-fan-out is not supported on Windows.\n"sv;
+        return 1;
+#else
+        return RunStdFanOut([&] { return runInsights(op.getSourcePathList()); }, variantArgs);
+#endif /* _WIN32 */
     }
 
-    return tool.run(newFrontendActionFactory<CppInsightFrontendAction>().get());
+    return runInsights(op.getSourcePathList());
 }
 //-----------------------------------------------------------------------------
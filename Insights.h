@@ -20,6 +20,9 @@ struct InsightsOptions
 {
 #define INSIGHTS_OPT(opt, name, deflt, description, category) bool name;
 #include "InsightsOptions.def"
+
+    unsigned LambdaSBOSize;  //!< The small buffer size a lambda closure is compared against, 0 selects the one of
+                             //!< \c std::function.
 };
 //-----------------------------------------------------------------------------
 
@@ -1397,6 +1397,47 @@ bool IsTrivialStaticClassVarDecl(const VarDecl& varDecl)
 }
 //-----------------------------------------------------------------------------
 
+bool IsCoroutine(const FunctionDecl* fd)
+{
+    if(not fd) {
+        return false;
+
+    } else if(const auto* definition = fd->getDefinition()) {
+        return isa_and_nonnull<CoroutineBodyStmt>(definition->getBody());
+
+    } else if(const auto* record = fd->getReturnType()->getAsCXXRecordDecl(); record and record->hasDefinition()) {
+        return not record->lookup(&GetGlobalAST().Idents.get("promise_type"sv)).empty();
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+std::optional<std::string_view> GetHALOBlocker(const FunctionDecl& coroutine)
+{
+    // The caller has to inline the coroutine to be able to place the frame in its own frame.
+    const auto* definition = coroutine.getDefinition();
+
+    if(not definition) {
+        return "definition not visible"sv;
+
+    } else if(definition->hasAttr<NoInlineAttr>()) {
+        return "coroutine is noinline"sv;
+
+    } else if(const auto* method = dyn_cast_or_null<CXXMethodDecl>(definition); method and method->isVirtual()) {
+        return "virtual coroutine"sv;
+    }
+
+    // Only a return object which destroys the coroutine ends its lifetime in the caller.
+    if(const auto* record = definition->getReturnType()->getAsCXXRecordDecl();
+       record and record->hasDefinition() and not record->hasNonTrivialDestructor()) {
+        return "return type does not destroy the coroutine"sv;
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
 std::string GetName(const DeclRefExpr& declRefExpr)
 {
     const auto* declRefDecl = declRefExpr.getDecl();
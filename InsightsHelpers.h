@@ -98,6 +98,16 @@ bool IsEvaluatable(const VarDecl& varDecl);
 bool IsTrivialStaticClassVarDecl(const VarDecl& varDecl);
 //-----------------------------------------------------------------------------
 
+/// \brief Check whether \p fd is a coroutine.
+///
+/// Without a visible definition the return type decides, it has to provide a \c promise_type.
+bool IsCoroutine(const FunctionDecl* fd);
+//-----------------------------------------------------------------------------
+
+/// \brief Get the reason why the frame allocation of the coroutine \p coroutine can never be elided (HALO), if any.
+std::optional<std::string_view> GetHALOBlocker(const FunctionDecl& coroutine);
+//-----------------------------------------------------------------------------
+
 /*
  * Get the name of a DeclRefExpr without the namespace
  */
@@ -270,6 +280,13 @@ public:
     /// the last item is skipped.
     static std::string RemoveCurrentScope(std::string name);
 
+    /// \brief Forget the scopes of a transformation which crashed, see \c ResetGeneratorState.
+    static void Reset()
+    {
+        mGlobalStack = {};
+        mScope.clear();
+    }
+
 private:
     using ScopeStackType = StackList<ScopeHelper>;
 
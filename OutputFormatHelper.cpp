@@ -18,6 +18,7 @@ namespace clang::insights {
 void OutputFormatHelper::Indent(unsigned count)
 {
     mOutput.insert(mOutput.size(), count, ' ');
+    CheckMaxSize();
 }
 //-----------------------------------------------------------------------------
 
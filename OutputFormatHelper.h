@@ -9,6 +9,7 @@
 #define OUTPUT_FORMAT_HELPER_H
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <string_view>
 #include <utility>
 using namespace std::literals;
@@ -42,7 +43,23 @@ public:
     size_t CurrentPos() const { return mOutput.length(); }
 
     /// \brief Insert a string before the position \c atPos
-    void InsertAt(const size_t atPos, std::string_view data) { mOutput.insert(atPos, data); }
+    ///
+    /// A position behind the end, which a truncation to the maximum size cut off, inserts at the end.
+    void InsertAt(const size_t atPos, std::string_view data)
+    {
+        mOutput.insert(std::min(atPos, mOutput.size()), data);
+        CheckMaxSize();
+    }
+
+    /// \brief Cut the buffer at \c maxSize bytes from here on, zero means no limit.
+    void SetMaxSize(const size_t maxSize)
+    {
+        mMaxSize = maxSize;
+        CheckMaxSize();
+    }
+
+    /// \brief Whether the buffer was cut at the size set with \ref SetMaxSize.
+    bool MaxSizeReached() const { return mMaxSizeReached; }
 
     STRONG_BOOL(SkipIndenting);
 
@@ -81,27 +98,39 @@ public:
     /// \brief Append a single character
     ///
     /// Append a single character to the buffer
-    void Append(const char c) { mOutput += c; }
+    void Append(const char c)
+    {
+        mOutput += c;
+        CheckMaxSize();
+    }
 
-    void Append(const std::string_view& arg) { mOutput += arg; }
+    void Append(const std::string_view& arg)
+    {
+        mOutput += arg;
+        CheckMaxSize();
+    }
 
     /// \brief Append a variable number of data
     ///
     /// The \c StrCat function which is used ensures, that a \c StringRef or a char are converted appropriately.
-    void Append(const auto&... args) { details::StrCat(mOutput, args...); }
+    void Append(const auto&... args)
+    {
+        details::StrCat(mOutput, args...);
+        CheckMaxSize();
+    }
 
     /// \brief Same as \ref Append but adds a newline after the last argument.
     ///
     /// Append a single character to the buffer
     void AppendNewLine(const char c)
     {
-        mOutput += c;
+        Append(c);
         NewLine();
     }
 
     void AppendNewLine(const std::string_view& arg)
     {
-        mOutput += arg;
+        Append(arg);
         NewLine();
     }
 
@@ -109,7 +138,7 @@ public:
     void AppendNewLine(const auto&... args)
     {
         if constexpr(0 < sizeof...(args)) {
-            details::StrCat(mOutput, args...);
+            Append(args...);
         }
 
         NewLine();
@@ -194,7 +223,7 @@ public:
     void AppendSemiNewLine(const Args&... args)
     {
         if constexpr(0 < sizeof...(args)) {
-            details::StrCat(mOutput, args...);
+            Append(args...);
         }
 
         AppendNewLine(';');
@@ -202,7 +231,7 @@ public:
 
     void AppendSemiNewLine(const std::string_view& arg)
     {
-        mOutput += arg;
+        Append(arg);
         AppendNewLine(';');
     }
 
@@ -238,6 +267,8 @@ private:
     static constexpr unsigned SCOPE_INDENT{2};
     unsigned                  mDefaultIndent{};
     std::string               mOutput{};
+    size_t                    mMaxSize{};         //!< Cut the buffer at this size, zero means no limit.
+    bool                      mMaxSizeReached{};  //!< The buffer was cut at \c mMaxSize.
 
     void Indent(unsigned count);
     void NewLine()
@@ -246,6 +277,15 @@ private:
         Indent(mDefaultIndent);
     }
 
+    /// \brief Cut the buffer at the maximum size, in each append to bound it within a single large declaration.
+    void CheckMaxSize()
+    {
+        if(mMaxSize and (mOutput.size() > mMaxSize)) {
+            mOutput.resize(mMaxSize);
+            mMaxSizeReached = true;
+        }
+    }
+
     void RemoveIndent();
 };
 //-----------------------------------------------------------------------------
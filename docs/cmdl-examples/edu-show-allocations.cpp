@@ -0,0 +1,8 @@
+int main()
+{
+    int* p = new int{2};
+    int* a = new int[8]{};
+
+    delete[] a;
+    delete p;
+}
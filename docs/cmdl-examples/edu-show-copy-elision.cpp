@@ -0,0 +1,34 @@
+struct Data
+{
+    Data() {}
+    Data(const Data&) {}
+    Data(Data&&) {}
+};
+
+Data Guaranteed()
+{
+    return Data{};
+}
+
+Data Named()
+{
+    Data d;
+    return d;
+}
+
+Data Two(bool b)
+{
+    Data x;
+    Data y;
+
+    if(b) {
+        return x;
+    }
+
+    return y;
+}
+
+Data Copy(const Data& d)
+{
+    return d;
+}
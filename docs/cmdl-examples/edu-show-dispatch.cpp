@@ -0,0 +1,14 @@
+struct Base
+{
+    virtual int Get() { return 1; }
+};
+
+struct Derived final : Base
+{
+    int Get() override { return 3; }
+};
+
+int Call(Base& b, Derived& d)
+{
+    return b.Get() + d.Get();
+}
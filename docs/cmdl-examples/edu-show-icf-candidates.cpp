@@ -0,0 +1,16 @@
+template<typename T>
+T First(const T* values)
+{
+    return values[0];
+}
+
+int main()
+{
+    int    i[2]{1, 2};
+    float  f[2]{1.5F, 2.5F};
+    double d[2]{1.5, 2.5};
+
+    First(i);
+    First(f);
+    First(d);
+}
@@ -0,0 +1,28 @@
+struct Base
+{
+    virtual int Get() const { return 1; }
+};
+
+struct Data
+{
+    Data() {}
+    Data(const Data&) {}
+    ~Data() {}
+
+    int value;
+};
+
+int Use(const Base& b, Data (&arr)[2], int n)
+{
+    int sum = 0;
+
+    for(Data d : arr) {
+        sum += b.Get();
+    }
+
+    while(n) {
+        --n;
+    }
+
+    return sum;
+}
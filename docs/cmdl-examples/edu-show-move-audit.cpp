@@ -0,0 +1,19 @@
+struct Data
+{
+    Data() {}
+    Data(const Data&) {}
+    Data(Data&&) {}
+};
+
+void Consume(Data d)
+{
+}
+
+void Use()
+{
+    Data d;
+    Data e;
+    Consume(e);
+    Consume(d);
+    Consume(e);
+}
@@ -0,0 +1,17 @@
+struct Simple
+{
+    int a;
+};
+
+struct Throwing
+{
+    Throwing() {}
+    Throwing(Throwing&&) {}
+    Throwing& operator=(Throwing&&) noexcept { return *this; }
+};
+
+int main()
+{
+    Simple   s{};
+    Throwing t{};
+}
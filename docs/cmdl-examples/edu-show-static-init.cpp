@@ -0,0 +1,29 @@
+void X() noexcept(false) { throw; }
+
+class Sing
+{
+public:
+    Sing() { X(); }
+    ~Sing() {}
+};
+
+int Compute() { return 3; }
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+Sing            sing;
+int             computed = Compute();
+Point           origin{1, 2};
+const Point     unit{1, 1};
+constexpr Point zero{0, 0};
+
+Sing & Test()
+{
+    static Sing s;
+
+    return s;
+}
@@ -0,0 +1,28 @@
+struct Data
+{
+    int a;
+    int b;
+};
+
+Data Make()
+{
+    return Data{1, 2};
+}
+
+int Use(const Data& d)
+{
+    return d.a;
+}
+
+int main()
+{
+    const Data& ref = Make();
+
+    int sum = ref.b;
+
+    for(int i = 0; i < 2; ++i) {
+        sum += Use(Make());
+    }
+
+    return sum;
+}
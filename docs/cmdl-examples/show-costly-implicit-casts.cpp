@@ -0,0 +1,9 @@
+int main()
+{
+    int    i = 3;
+    double d = i;
+    int    n = d;
+    short  s = n;
+
+    return n + s;
+}
@@ -0,0 +1,7 @@
+#include <string>
+#include <vector>
+
+int main()
+{
+    std::vector<int> v{2, 3};
+}
@@ -0,0 +1,50 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+#------------------------------------------------------------------------------
+#
+# Pack all files below the given include directories into a single header archive for -header-archive.
+#
+# The format is a first line 'insights-header-archive 1', followed by a line 'root <dir>' for each packed directory.
+# Each file follows as a line 'file <size> <path>', then the <size> bytes of the file and a terminating NUL byte.
+#
+#------------------------------------------------------------------------------
+
+import os
+import sys
+
+def main():
+    if 3 > len(sys.argv):
+        print('Usage: %s <archive> <include dir>...' % sys.argv[0])
+        return 1
+
+    roots = [os.path.normpath(os.path.abspath(d)) for d in sys.argv[2:] if os.path.isdir(d)]
+
+    with open(sys.argv[1], 'wb') as archive:
+        archive.write(b'insights-header-archive 1\n')
+
+        for root in roots:
+            archive.write(('root %s\n' % root).encode())
+
+        for root in roots:
+            for dirPath, dirNames, fileNames in os.walk(root):
+                dirNames.sort()
+
+                for fileName in sorted(fileNames):
+                    path = os.path.join(dirPath, fileName)
+
+                    with open(path, 'rb') as f:
+                        content = f.read()
+
+                    archive.write(('file %d %s\n' % (len(content), path)).encode())
+                    archive.write(content)
+                    archive.write(b'\0')
+
+    return 0
+#------------------------------------------------------------------------------
+
+sys.exit(main())
+#------------------------------------------------------------------------------
@@ -0,0 +1,44 @@
+// cmdline:-std=c++2a
+// cmdlineinsights:-edu-show-coroutine-frame
+
+#include <coroutine>
+#include <exception> // std::terminate
+#include <new>
+#include <utility>
+
+struct generator {
+  struct promise_type {
+    int current_value{};
+
+    std::suspend_always yield_value(int value) {
+      current_value = value;
+      return {};
+    }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    generator get_return_object() { return generator{this}; };
+    void unhandled_exception() { std::terminate(); }
+    void return_value(int v) { current_value = v; }
+  };
+
+  generator(generator &&rhs) : p{std::exchange(rhs.p, nullptr)} {}
+  ~generator() { if (p) { p.destroy(); } }
+
+private:
+  explicit generator(promise_type* _p)
+      : p{std::coroutine_handle<promise_type>::from_promise(*_p)} {}
+
+  std::coroutine_handle<promise_type> p;
+};
+
+generator fun() {
+  int a = 1;
+  int b = a + 1;
+  co_yield b;
+  co_return b;
+}
+
+int main() {
+  auto s = fun();
+}
+
@@ -0,0 +1,37 @@
+// cmdlineinsights:-edu-show-allocations
+
+#include <functional>
+#include <memory>
+#include <string>
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+struct Counted
+{
+    long n;
+    Counted(long v) : n{v} {}
+    Counted(const Counted& other) : n{other.n} {}
+};
+
+int main()
+{
+    std::shared_ptr<int> shared = std::make_shared<int>(2);
+    std::unique_ptr<Point> unique = std::make_unique<Point>();
+
+    long a = 1;
+    long b = 2;
+    long c = 3;
+
+    std::function<long()> large = [a, b, c] { return c; };
+    std::function<long()> small = [a] { return a; };
+
+    std::string longText{"this text does not fit into the small buffer"};
+    std::string shortText{"short"};
+
+    Counted counted{a};
+    std::function<long()> copies = [counted] { return counted.n; };
+}
@@ -0,0 +1,8 @@
+// cmdlineinsights:-edu-show-allocations
+
+void Loop()
+{
+    for(int* p = new int{2}; p; p = nullptr) {
+        delete p;
+    }
+}
@@ -0,0 +1,24 @@
+// cmdlineinsights:-edu-show-allocations
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+Point* Create()
+{
+    return new Point{1, 2};
+}
+
+int main()
+{
+    int* p = new int{2};
+    int* a = new int[8]{};
+
+    Point* pt = Create();
+
+    delete pt;
+    delete[] a;
+    delete p;
+}
@@ -0,0 +1,19 @@
+// cmdlineinsights:-edu-show-copy-elision -edu-show-lifetime
+
+struct Data
+{
+    Data() {}
+    Data(const Data&) {}
+    Data(Data&&) {}
+};
+
+Data Named()
+{
+    Data d;
+    return d;
+}
+
+Data Copy(const Data& d)
+{
+    return d;
+}
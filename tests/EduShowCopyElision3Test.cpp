@@ -0,0 +1,18 @@
+// cmdlineinsights:-edu-show-copy-elision -edu-show-cfront
+
+struct Data
+{
+    Data() {}
+    Data(const Data&) {}
+};
+
+Data Named()
+{
+    Data d;
+    return d;
+}
+
+Data Copy(const Data& d)
+{
+    return d;
+}
@@ -0,0 +1,36 @@
+// cmdlineinsights:-edu-show-copy-elision
+
+struct Data
+{
+    Data() {}
+    Data(const Data&) {}
+    Data(Data&&) {}
+};
+
+Data Guaranteed()
+{
+    return Data{};
+}
+
+Data Named()
+{
+    Data d;
+    return d;
+}
+
+Data Two(bool b)
+{
+    Data x;
+    Data y;
+
+    if(b) {
+        return x;
+    }
+
+    return y;
+}
+
+Data Copy(const Data& d)
+{
+    return d;
+}
@@ -0,0 +1,20 @@
+// cmdlineinsights:-edu-show-dispatch
+
+struct Base
+{
+    virtual int Get() { return 1; }
+    int Plain() { return 2; }
+};
+
+struct Derived final : Base
+{
+    int Get() override { return 3; }
+};
+
+int Call(Base& b, Derived& d)
+{
+    int r = b.Get();
+    r += d.Get();
+    r += b.Plain();
+    return r;
+}
@@ -0,0 +1,21 @@
+// cmdlineinsights:-edu-show-icf-candidates
+template<typename T>
+T First(const T* values)
+{
+    return values[0];
+}
+
+int main()
+{
+    int       i[2]{1, 2};
+    float     f[2]{1.5F, 2.5F};
+    double    d[2]{1.5, 2.5};
+    long      l[2]{1L, 2L};
+    long long ll[2]{1LL, 2LL};
+
+    First(i);
+    First(f);
+    First(d);
+    First(l);
+    First(ll);
+}
@@ -0,0 +1,10 @@
+// cmdlineinsights:-edu-show-lambda-layout -edu-lambda-sbo-size=8
+
+int main()
+{
+  int i = 1;
+  char c = 2;
+  double d = 3.5;
+
+  auto l = [i, c, d] { return d; };
+}
@@ -0,0 +1,39 @@
+// cmdlineinsights:-edu-show-move-audit
+
+#include <utility>
+
+struct Data
+{
+    Data() {}
+    Data(const Data&) {}
+    Data(Data&&) {}
+};
+
+void Consume(Data d)
+{
+}
+
+void Observe(const Data& d)
+{
+}
+
+void ConstMove()
+{
+    const Data c;
+    Consume(std::move(c));
+}
+
+void ConstMoveWithoutCopy()
+{
+    const Data c;
+    Observe(std::move(c));
+
+    const int i = 1;
+    int j = std::move(i);
+}
+
+Data ReturnMove()
+{
+    Data d;
+    return std::move(d);
+}
@@ -0,0 +1,43 @@
+// cmdlineinsights:-edu-show-noexcept-moves
+
+#include <deque>
+#include <vector>
+
+struct Simple {
+  int a;
+};
+
+struct Throwing {
+  Throwing() {}
+  Throwing(Throwing&&) {}
+  Throwing& operator=(Throwing&&) noexcept { return *this; }
+};
+
+struct Holder {
+  Throwing t;
+};
+
+struct Copyable {
+  Copyable() {}
+  Copyable(const Copyable&) {}
+};
+
+struct NothrowCopy {
+  NothrowCopy() {}
+  NothrowCopy(const NothrowCopy&) noexcept {}
+};
+
+struct NothrowCopyHolder {
+  NothrowCopy n;
+};
+
+int main()
+{
+  Simple s{};
+  Throwing t{};
+
+  std::vector<Throwing>* v = nullptr;
+  std::deque<Throwing>*  d = nullptr;
+  std::vector<Copyable>* c = nullptr;
+  std::vector<NothrowCopyHolder>* h = nullptr;
+}
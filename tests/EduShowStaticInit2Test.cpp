@@ -0,0 +1,14 @@
+// cmdlineinsights:-edu-show-static-init
+
+int Compute() { return 3; }
+
+struct Config
+{
+    static int limit;
+};
+
+extern int counter;
+int counter = Compute();
+extern int counter;
+int zeroed;
+int Config::limit = Compute();
@@ -0,0 +1,20 @@
+// cmdlineinsights:-edu-show-template-costs
+template<typename T>
+struct Box
+{
+    T value;
+};
+
+template<typename T>
+T Get(const Box<T>& b)
+{
+    return b.value;
+}
+
+int main()
+{
+    Box<int>  bi{2};
+    Box<char> bc{'a'};
+
+    return Get(bi);
+}
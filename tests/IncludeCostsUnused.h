@@ -0,0 +1,6 @@
+#pragma once
+
+inline int Unused()
+{
+    return 1;
+}
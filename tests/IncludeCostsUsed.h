@@ -0,0 +1,8 @@
+#pragma once
+
+struct Used
+{
+    int value;
+};
+
+int Twice(int v);
@@ -0,0 +1,11 @@
+// cmdlineinsights:-show-costly-implicit-casts
+
+int main()
+{
+    int    i = 3;
+    double d = i;
+    int    n = d;
+    short  s = n;
+
+    return n + s;
+}
@@ -0,0 +1,10 @@
+// cmdlineinsights:-show-include-costs -include-cost-times=false
+
+#include "IncludeCostsUsed.h"
+#include "IncludeCostsUnused.h"
+#include "IncludeCostsUsed.h"
+
+int Get(Used u)
+{
+    return u.value;
+}
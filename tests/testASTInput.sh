@@ -0,0 +1,44 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+insights=$1
+clang=$2
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+echo 'struct Point { int x; int y; };' > "$tmpDir/Point.h"
+
+cat > "$tmpDir/Main.cpp" << 'SOURCE'
+#include "Point.h"
+
+#define INSIGHTS_AST_INPUT
+
+int Sum(const Point (&points)[2])
+{
+    int sum{};
+    for(const auto& p : points) { sum += p.x + p.y; }
+    return sum;
+}
+SOURCE
+
+$insights "$tmpDir/Main.cpp" -- -std=c++17 > "$tmpDir/expected"
+
+# With a preprocessing record the AST transforms like the source, includes and INSIGHTS_ defines included
+$clang -std=c++17 -emit-ast -Xclang -detailed-preprocessing-record "$tmpDir/Main.cpp" -o "$tmpDir/Main.ast"
+$insights "$tmpDir/Main.ast" -- > "$tmpDir/out"
+cmp "$tmpDir/expected" "$tmpDir/out"
+
+# Without one the includes and defines are missing, everything else stays the same
+withoutDirectives() {
+    grep -v -e '^#include ' -e '^#define INSIGHTS_' -e '^$' "$1" || true
+}
+
+$clang -std=c++17 -emit-ast "$tmpDir/Main.cpp" -o "$tmpDir/Main.ast"
+$insights "$tmpDir/Main.ast" -- > "$tmpDir/out"
+[ 0 -eq $(grep -c -e '^#include ' -e '^#define INSIGHTS_' "$tmpDir/out" || true) ]
+cmp <(withoutDirectives "$tmpDir/expected") <(withoutDirectives "$tmpDir/out")
+
+exit 0
@@ -0,0 +1,32 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+insights=$1
+
+# Only a debug build has -debug-crash-in
+if ! $insights --version | grep -q "Build with debug enabled"; then
+    exit 0
+fi
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+echo 'int Crash() { return 1; }' > "$tmpDir/First.cpp"
+echo 'int Fine() { return 2; }' > "$tmpDir/Second.cpp"
+
+$insights "$tmpDir/Second.cpp" -- -std=c++17 > "$tmpDir/expected"
+
+# A crash in the first translation unit still transforms the second one, the run ends with status 5
+status=0
+$insights "$tmpDir/First.cpp" "$tmpDir/Second.cpp" -debug-crash-in=Crash -- -std=c++17 > "$tmpDir/out" \
+    2> "$tmpDir/err" || status=$?
+[ 5 -eq $status ]
+
+tail -c $(wc -c < "$tmpDir/expected") "$tmpDir/out" | cmp - "$tmpDir/expected"
+
+# The report names the declaration which crashed
+grep -q "First.cpp:1:5: error: C++ Insights crashed while transforming this Function declaration 'Crash'" "$tmpDir/err"
+
+exit 0
@@ -0,0 +1,38 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+insights=$1
+testCppfile="EduShowStaticInit2Test.cpp"
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+echo 'int main() { return x; }' > "$tmpDir/Error.cpp"
+
+# The response to the request number $2 for the file $1, taken from a direct run
+response() {
+    local status=0
+    $insights "$1" -- -std=c++17 > "$tmpDir/out" 2> "$tmpDir/err" || status=$?
+
+    echo "$status $(( $(wc -c < "$tmpDir/out") )) $(( $(wc -c < "$tmpDir/err") )) $2"
+    cat "$tmpDir/out" "$tmpDir/err"
+}
+
+# Each request transforms like a direct run, the errors are part of the response
+printf '%s\n%s\n' "$testCppfile" "$tmpDir/Error.cpp" > "$tmpDir/requests"
+$insights -fork-server $testCppfile -- -std=c++17 < "$tmpDir/requests" > "$tmpDir/responses" 2> /dev/null
+
+{ response "$testCppfile" 1; response "$tmpDir/Error.cpp" 2; } > "$tmpDir/expected"
+cmp "$tmpDir/responses" "$tmpDir/expected"
+
+# The second request of client a cancels the waiting first one, the third one finds the queue full
+printf 'a\t0\t%s\na\t0\t%s\n%s\n' "$testCppfile" "$testCppfile" "$testCppfile" > "$tmpDir/requests"
+$insights -fork-server -fork-server-max-queue=1 $testCppfile -- -std=c++17 < "$tmpDir/requests" \
+    > "$tmpDir/responses" 2> /dev/null
+
+{ echo "4 0 0 1"; echo "6 0 0 3"; response "$testCppfile" 2; } > "$tmpDir/expected"
+cmp "$tmpDir/responses" "$tmpDir/expected"
+
+exit 0
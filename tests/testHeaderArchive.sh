@@ -0,0 +1,42 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+insights=$1
+packHeaders="$(dirname "$0")/../scripts/pack-headers.py"
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+mkdir -p "$tmpDir/include/nested"
+echo 'inline int Packed() { return 1; }' > "$tmpDir/include/Packed.h"
+echo 'inline int Nested() { return 2; }' > "$tmpDir/include/nested/Nested.h"
+
+cat > "$tmpDir/Main.cpp" << 'SOURCE'
+#include <Packed.h>
+#include <nested/Nested.h>
+
+int main() { return Packed() + Nested(); }
+SOURCE
+
+$insights "$tmpDir/Main.cpp" -- -std=c++17 -I "$tmpDir/include" > "$tmpDir/expected"
+
+python3 "$packHeaders" "$tmpDir/headers.pack" "$tmpDir/include"
+
+# The headers now exist only in the archive, the output stays the same
+rm -rf "$tmpDir/include"
+$insights "$tmpDir/Main.cpp" -header-archive="$tmpDir/headers.pack" -- -std=c++17 -I "$tmpDir/include" > "$tmpDir/out"
+cmp "$tmpDir/expected" "$tmpDir/out"
+
+# Without the archive the headers are missing
+status=0
+$insights "$tmpDir/Main.cpp" -- -std=c++17 -I "$tmpDir/include" > /dev/null 2>&1 || status=$?
+[ 1 -eq $status ]
+
+# An explicitly requested archive must exist
+status=0
+$insights "$tmpDir/Main.cpp" -header-archive="$tmpDir/missing.pack" -- -std=c++17 > /dev/null 2>&1 || status=$?
+[ 1 -eq $status ]
+
+exit 0
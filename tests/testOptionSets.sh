@@ -0,0 +1,37 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+insights=$1
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+# Transform $1 with the arguments $3 once regularly and then with the option $2 in two option sets. Each set must
+# transform like a standalone run with $2, although the earlier passes replaced nodes in the AST. $4 are further
+# options of C++ Insights for all runs.
+check() {
+    local testCppfile=$1
+    local option=$2
+    local args=$3
+    local insightsArgs=$4
+
+    {
+        $insights $testCppfile $insightsArgs -- $args
+        printf '\n// -option-set: %s\n\n' $option
+        $insights $testCppfile $insightsArgs -$option -- $args
+        printf '\n// -option-set: %s\n\n' $option
+        $insights $testCppfile $insightsArgs -$option -- $args
+    } > "$tmpDir/expected"
+
+    $insights $testCppfile $insightsArgs -option-set=$option -option-set=$option -- $args > "$tmpDir/sets"
+
+    cmp "$tmpDir/sets" "$tmpDir/expected"
+}
+
+check EduLifeTimeTest12.cpp edu-show-lifetime -std=c++17
+check EduCoroutineSimpleTest.cpp edu-show-coroutine-transformation -std=c++2a
+check ShowIncludeCostsTest.cpp show-include-costs -std=c++17 -include-cost-times=false
+
+exit 0
@@ -0,0 +1,69 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+testCppfile="EduShowStaticInit2Test.cpp"
+options="-edu-show-static-init"
+
+full=$($1 $testCppfile $options -- -std=c++17)
+
+# A limit above the size of the output changes nothing
+limited=$($1 $testCppfile $options -max-output-bytes=100000 -- -std=c++17)
+[ "$full" == "$limited" ]
+
+# The output is cut at the limit, here inside the first declaration, and the reports are left out
+status=0
+limited=$($1 $testCppfile $options -max-output-bytes=10 -- -std=c++17) || status=$?
+[ 3 -eq $status ]
+
+expected="$(head -c 10 <<< "$full")
+/* Output truncated: -max-output-bytes exceeded */"
+[ "$expected" == "$limited" ]
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+# Each translation unit starts afresh, the one after a truncated one is complete
+echo 'int small = 1;' > "$tmpDir/Small.cpp"
+$1 $testCppfile -max-output-bytes=100 -- -std=c++17 > "$tmpDir/first" || true
+$1 "$tmpDir/Small.cpp" -max-output-bytes=100 -- -std=c++17 > "$tmpDir/second"
+
+status=0
+$1 $testCppfile "$tmpDir/Small.cpp" -max-output-bytes=100 -- -std=c++17 > "$tmpDir/both" || status=$?
+[ 3 -eq $status ]
+cat "$tmpDir/first" "$tmpDir/second" | cmp - "$tmpDir/both"
+
+# A runaway instantiation inside a single declaration is stopped while Sema instantiates, not once it is done
+cat > "$tmpDir/Runaway.cpp" << 'SOURCE'
+template<unsigned N, unsigned M>
+struct Grid {
+  static constexpr unsigned long value = Grid<N - 1, M>::value + Grid<N, M - 1>::value;
+};
+
+template<>
+struct Grid<0, 0> {
+  static constexpr unsigned long value = 1;
+};
+
+template<unsigned M>
+struct Grid<0, M> {
+  static constexpr unsigned long value = 1;
+};
+
+template<unsigned N>
+struct Grid<N, 0> {
+  static constexpr unsigned long value = 1;
+};
+
+constexpr unsigned long paths = Grid<400, 400>::value;
+SOURCE
+
+status=0
+$1 "$tmpDir/Runaway.cpp" -deadline-ms=100 -- -std=c++17 -ftemplate-depth=4096 > "$tmpDir/out" 2> "$tmpDir/err" ||
+    status=$?
+[ 3 -eq $status ]
+grep -q "Runaway.cpp:[0-9]*:[0-9]*: fatal error: -deadline-ms exceeded, stopping" "$tmpDir/err"
+grep -q "/\* Output truncated: -deadline-ms exceeded \*/" "$tmpDir/out"
+
+exit 0
@@ -0,0 +1,79 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+insights=$1
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+shared="$tmpDir/shared.txt"
+
+cat > "$tmpDir/Shared.h" << 'SOURCE'
+#pragma once
+
+struct Point { int x; int y; };
+
+inline int Sum(const Point& p) { return p.x + p.y; }
+SOURCE
+
+for tu in A B; do
+    cat > "$tmpDir/$tu.cpp" << SOURCE
+#include "Shared.h"
+
+int $tu() { Point p{1, 2}; return Sum(p); }
+SOURCE
+done
+
+# How often the shared file holds a declaration with the kind and name $1
+count() {
+    grep -c "^// insights-shared: $1 " "$shared" || true
+}
+
+# Two translation units at the same time store each header declaration only once
+$insights "$tmpDir/A.cpp" -shared-output="$shared" -- -std=c++17 > "$tmpDir/A.out" &
+pidA=$!
+$insights "$tmpDir/B.cpp" -shared-output="$shared" -- -std=c++17 > "$tmpDir/B.out" &
+pidB=$!
+wait $pidA
+wait $pidB
+
+[ 1 -eq $(count "CXXRecord Point") ]
+[ 1 -eq $(count "Function Sum") ]
+
+# Both refer to the copies in the shared file
+for tu in A B; do
+    while read -r key; do
+        grep -q -x -F "/* Shared: $key */" "$tmpDir/$tu.out"
+    done < <(sed -n 's|^// insights-shared: ||p' "$shared")
+done
+
+# Another run with the same options adds nothing
+cp "$shared" "$tmpDir/before"
+$insights "$tmpDir/A.cpp" -shared-output="$shared" -- -std=c++17 > /dev/null
+cmp "$shared" "$tmpDir/before"
+
+# Two processes one after another compute the same keys, the second one reuses the entries of the first
+rm "$shared"
+$insights "$tmpDir/A.cpp" -shared-output="$shared" -- -std=c++17 > /dev/null
+cp "$shared" "$tmpDir/before"
+$insights "$tmpDir/B.cpp" -shared-output="$shared" -- -std=c++17 > "$tmpDir/B.out"
+cmp "$shared" "$tmpDir/before"
+[ 1 -eq $(count "CXXRecord Point") ]
+[ 1 -eq $(count "Function Sum") ]
+
+while read -r key; do
+    grep -q -x -F "/* Shared: $key */" "$tmpDir/B.out"
+done < <(sed -n 's|^// insights-shared: ||p' "$shared")
+
+# Another standard generates the declarations under other keys
+$insights "$tmpDir/A.cpp" -shared-output="$shared" -- -std=c++20 > /dev/null
+[ 2 -eq $(count "CXXRecord Point") ]
+
+# The cfront transformation collects what the declarations contain, a declaration in the file would be missing
+status=0
+$insights "$tmpDir/A.cpp" -shared-output="$shared" -edu-show-cfront -- -std=c++17 > /dev/null 2>&1 || status=$?
+[ 1 -eq $status ]
+
+exit 0
@@ -0,0 +1,36 @@
+#! /bin/bash
+
+# fail immediately
+set -e
+
+insights=$1
+
+tmpDir=$(mktemp -d)
+trap 'rm -rf "$tmpDir"' EXIT
+
+# Both overloads share a line, only the second one transforms differently
+cat > "$tmpDir/FanOut.cpp" << 'SOURCE'
+int f(int i) { return i; } int f(double) {
+#if __cplusplus > 201703L
+  return 20;
+#else
+  return 17;
+#endif
+}
+SOURCE
+
+# Each variant transforms like a standalone run with its standard, the summary names only the second overload
+{
+    printf '// -std-fan-out: c++17\n\n'
+    $insights "$tmpDir/FanOut.cpp" -- -std=c++17
+    printf '\n// -std-fan-out: c++20\n\n'
+    $insights "$tmpDir/FanOut.cpp" -- -std=c++20
+    printf '\n/* Declarations which transform differently: */\n'
+    printf '/* line 1 Function f int (double): c++17 | c++20 */\n'
+} > "$tmpDir/expected"
+
+$insights "$tmpDir/FanOut.cpp" -std-fan-out=c++17,c++20 -- > "$tmpDir/fanOut"
+
+cmp "$tmpDir/fanOut" "$tmpDir/expected"
+
+exit 0